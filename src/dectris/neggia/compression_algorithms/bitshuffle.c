@@ -14,9 +14,28 @@
 #include "lz4.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 
+// On x86 all variants are compiled with function specific target attributes
+// and the best one supported by the CPU is selected at runtime. Otherwise the
+// instruction set is chosen at compile time.
+#if (defined(__x86_64__) || defined(__i386__)) && \
+        (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define BSHUF_RUNTIME_DISPATCH
+#define USEAVX2
+#define USESSE2
+#define BSHUF_TARGET_SSE2 __attribute__((target("sse2")))
+#define BSHUF_TARGET_AVX2 __attribute__((target("avx2")))
+#if (defined(__clang__) && __clang_major__ >= 7) || \
+        (!defined(__clang__) && __GNUC__ >= 8)
+#define USEAVX512
+#define BSHUF_TARGET_AVX512 \
+        __attribute__((target("avx512f,avx512bw,avx512vbmi,gfni")))
+#include <cpuid.h>
+#endif
+#else
 #if defined(__AVX2__) && defined (__SSE2__)
 #define USEAVX2
 #endif
@@ -24,6 +43,9 @@
 #if defined(__SSE2__)
 #define USESSE2
 #endif
+#define BSHUF_TARGET_SSE2
+#define BSHUF_TARGET_AVX2
+#endif
 
 
 // Conditional includes for SSE2 and AVX2.
@@ -52,23 +74,94 @@
     free(buf); return count - 1000; }
 
 
-/* ---- Functions indicating compile time instruction set. ---- */
+/* ---- Selection of the instruction set. ---- */
 
-int bshuf_using_SSE2(void) {
-#ifdef USESSE2
-    return 1;
-#else
-    return 0;
+enum {
+    BSHUF_SCALAR = 0,
+    BSHUF_SSE2 = 1,
+    BSHUF_AVX2 = 2,
+    BSHUF_AVX512 = 3
+};
+
+
+#ifdef USEAVX512
+/* AVX-512BW support is checked with the compiler builtin, which includes the
+ * check that the operating system saves the AVX-512 registers. VBMI and GFNI
+ * are read from CPUID leaf 7 directly, older compilers do not know them. */
+static int bshuf_cpu_supports_AVX512(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__builtin_cpu_supports("avx512f") ||
+            !__builtin_cpu_supports("avx512bw")) {
+        return 0;
+    }
+    if (__get_cpuid_max(0, NULL) < 7) return 0;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    const unsigned int avx512vbmi = 1 << 1;
+    const unsigned int gfni = 1 << 8;
+    return (ecx & avx512vbmi) && (ecx & gfni);
+}
+#endif
+
+
+/* Best instruction set available, can be lowered with the environment
+ * variable NEGGIA_BITSHUFFLE_SIMD=scalar|sse2|avx2|avx512 for testing. */
+static int bshuf_detect_simd_level(void) {
+    int level = BSHUF_SCALAR;
+#ifdef BSHUF_RUNTIME_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        level = BSHUF_AVX2;
+#ifdef USEAVX512
+        if (bshuf_cpu_supports_AVX512()) level = BSHUF_AVX512;
+#endif
+    } else if (__builtin_cpu_supports("sse2")) {
+        level = BSHUF_SSE2;
+    }
+#elif defined(USEAVX2)
+    level = BSHUF_AVX2;
+#elif defined(USESSE2)
+    level = BSHUF_SSE2;
 #endif
+    const char* forced = getenv("NEGGIA_BITSHUFFLE_SIMD");
+    if (forced) {
+        if (strcmp(forced, "scalar") == 0) {
+            level = BSHUF_SCALAR;
+        } else if (strcmp(forced, "sse2") == 0) {
+            level = MIN(level, BSHUF_SSE2);
+        } else if (strcmp(forced, "avx2") == 0) {
+            level = MIN(level, BSHUF_AVX2);
+        } else if (strcmp(forced, "avx512") == 0) {
+            level = MIN(level, BSHUF_AVX512);
+        }
+    }
+    return level;
+}
+
+
+static int bshuf_simd_level(void) {
+    // Detection is idempotent, concurrent first calls may both detect.
+    static int detected_level = -1;
+    int level = __atomic_load_n(&detected_level, __ATOMIC_RELAXED);
+    if (level < 0) {
+        level = bshuf_detect_simd_level();
+        __atomic_store_n(&detected_level, level, __ATOMIC_RELAXED);
+    }
+    return level;
+}
+
+
+int bshuf_using_SSE2(void) {
+    return bshuf_simd_level() >= BSHUF_SSE2;
 }
 
 
 int bshuf_using_AVX2(void) {
-#ifdef USEAVX2
-    return 1;
-#else
-    return 0;
-#endif
+    return bshuf_simd_level() >= BSHUF_AVX2;
+}
+
+
+int bshuf_using_AVX512(void) {
+    return bshuf_simd_level() >= BSHUF_AVX512;
 }
 
 
@@ -330,6 +423,7 @@ int64_t bshuf_untrans_bit_elem_scal(void* in, void* out, const size_t size,
 #ifdef USESSE2
 
 /* Transpose bytes within elements for 16 bit elements. */
+BSHUF_TARGET_SSE2
 int64_t bshuf_trans_byte_elem_SSE_16(void* in, void* out, const size_t size) {
 
     char* in_b = (char*) in;
@@ -361,6 +455,7 @@ int64_t bshuf_trans_byte_elem_SSE_16(void* in, void* out, const size_t size) {
 
 
 /* Transpose bytes within elements for 32 bit elements. */
+BSHUF_TARGET_SSE2
 int64_t bshuf_trans_byte_elem_SSE_32(void* in, void* out, const size_t size) {
 
     char* in_b = (char*) in;
@@ -404,6 +499,7 @@ int64_t bshuf_trans_byte_elem_SSE_32(void* in, void* out, const size_t size) {
 
 
 /* Transpose bytes within elements for 64 bit elements. */
+BSHUF_TARGET_SSE2
 int64_t bshuf_trans_byte_elem_SSE_64(void* in, void* out, const size_t size) {
 
     char* in_b = (char*) in;
@@ -472,6 +568,7 @@ int64_t bshuf_trans_byte_elem_SSE_64(void* in, void* out, const size_t size) {
 
 
 /* Transpose bytes within elements using best SSE algorithm available. */
+BSHUF_TARGET_SSE2
 int64_t bshuf_trans_byte_elem_SSE(void* in, void* out, const size_t size,
          const size_t elem_size) {
 
@@ -534,6 +631,7 @@ int64_t bshuf_trans_byte_elem_SSE(void* in, void* out, const size_t size,
 
 
 /* Transpose bits within bytes. */
+BSHUF_TARGET_SSE2
 int64_t bshuf_trans_bit_byte_SSE(void* in, void* out, const size_t size,
          const size_t elem_size) {
 
@@ -566,6 +664,7 @@ int64_t bshuf_trans_bit_byte_SSE(void* in, void* out, const size_t size,
 
 
 /* Transpose bits within elements. */
+BSHUF_TARGET_SSE2
 int64_t bshuf_trans_bit_elem_SSE(void* in, void* out, const size_t size,
          const size_t elem_size) {
 
@@ -590,6 +689,7 @@ int64_t bshuf_trans_bit_elem_SSE(void* in, void* out, const size_t size,
 
 /* For data organized into a row for each bit (8 * elem_size rows), transpose
  * the bytes. */
+BSHUF_TARGET_SSE2
 int64_t bshuf_trans_byte_bitrow_SSE(void* in, void* out, const size_t size,
          const size_t elem_size) {
 
@@ -695,6 +795,7 @@ int64_t bshuf_trans_byte_bitrow_SSE(void* in, void* out, const size_t size,
 
 
 /* Shuffle bits within the bytes of eight element blocks. */
+BSHUF_TARGET_SSE2
 int64_t bshuf_shuffle_bit_eightelem_SSE(void* in, void* out, const size_t size,
          const size_t elem_size) {
 
@@ -731,6 +832,7 @@ int64_t bshuf_shuffle_bit_eightelem_SSE(void* in, void* out, const size_t size,
 
 
 /* Untranspose bits within elements. */
+BSHUF_TARGET_SSE2
 int64_t bshuf_untrans_bit_elem_SSE(void* in, void* out, const size_t size,
          const size_t elem_size) {
 
@@ -821,6 +923,7 @@ int64_t bshuf_shuffle_bit_eightelem_SSE(void* in, void* out, const size_t size,
 #ifdef USEAVX2
 
 /* Transpose bits within bytes. */
+BSHUF_TARGET_AVX2
 int64_t bshuf_trans_bit_byte_AVX(void* in, void* out, const size_t size,
          const size_t elem_size) {
 
@@ -851,6 +954,7 @@ int64_t bshuf_trans_bit_byte_AVX(void* in, void* out, const size_t size,
 
 
 /* Transpose bits within elements. */
+BSHUF_TARGET_AVX2
 int64_t bshuf_trans_bit_elem_AVX(void* in, void* out, const size_t size,
          const size_t elem_size) {
 
@@ -875,6 +979,7 @@ int64_t bshuf_trans_bit_elem_AVX(void* in, void* out, const size_t size,
 
 /* For data organized into a row for each bit (8 * elem_size rows), transpose
  * the bytes. */
+BSHUF_TARGET_AVX2
 int64_t bshuf_trans_byte_bitrow_AVX(void* in, void* out, const size_t size,
          const size_t elem_size) {
 
@@ -969,6 +1074,7 @@ int64_t bshuf_trans_byte_bitrow_AVX(void* in, void* out, const size_t size,
 
 
 /* Shuffle bits within the bytes of eight element blocks. */
+BSHUF_TARGET_AVX2
 int64_t bshuf_shuffle_bit_eightelem_AVX(void* in, void* out, const size_t size,
          const size_t elem_size) {
 
@@ -1005,6 +1111,7 @@ int64_t bshuf_shuffle_bit_eightelem_AVX(void* in, void* out, const size_t size,
 
 
 /* Untranspose bits within elements. */
+BSHUF_TARGET_AVX2
 int64_t bshuf_untrans_bit_elem_AVX(void* in, void* out, const size_t size,
          const size_t elem_size) {
 
@@ -1058,35 +1165,232 @@ int64_t bshuf_untrans_bit_elem_AVX(void* in, void* out, const size_t size,
 #endif // #ifdef USEAVX2
 
 
-/* ---- Drivers selecting best instruction set at compile time. ---- */
+/* ---- Worker code that uses AVX-512 ----
+ *
+ * The following code makes use of the AVX-512BW, AVX-512VBMI and GFNI
+ * instruction sets. They are present on Intel Ice Lake (2019) and AMD Zen 4
+ * (2022) and later processors. Only bit untransposition of 1, 2 and 4 byte
+ * elements is implemented, it reads the bit rows directly without an
+ * intermediate buffer. An 8x8 bit matrix held in a quadword is transposed
+ * with a single GF(2) affine transformation.
+ *
+ */
+
+#ifdef USEAVX512
+
+/* Untranspose the elements covered by the bytes [first_byte, nbyte_row) of
+ * the bit rows, one bit at a time. */
+static void bshuf_untrans_bit_elem_remainder(const char* in_b, char* out_b,
+        const size_t nbyte_row, const size_t first_byte,
+        const size_t elem_size) {
+
+    for (size_t ii = first_byte * 8; ii < nbyte_row * 8; ii++) {
+        for (size_t jj = 0; jj < elem_size; jj++) {
+            uint8_t byte = 0;
+            for (size_t kk = 0; kk < 8; kk++) {
+                uint8_t row_byte = in_b[(jj * 8 + kk) * nbyte_row + ii / 8];
+                byte |= ((row_byte >> (ii % 8)) & 1) << kk;
+            }
+            out_b[ii * elem_size + jj] = byte;
+        }
+    }
+}
+
+
+/* Byte kk of quadword jj is byte jj of bit row 7 - kk, taken from two
+ * registers holding 16 bytes of rows 0-3 and 4-7: 16 * (7 - kk) + jj.
+ * Reversing the rows turns the affine transformation into a transpose. */
+static const uint8_t BSHUF_GATHER_ROWS[64] = {
+        112, 96, 80, 64, 48, 32, 16, 0, 113, 97, 81, 65, 49, 33, 17, 1,
+        114, 98, 82, 66, 50, 34, 18, 2, 115, 99, 83, 67, 51, 35, 19, 3,
+        116, 100, 84, 68, 52, 36, 20, 4, 117, 101, 85, 69, 53, 37, 21, 5,
+        118, 102, 86, 70, 54, 38, 22, 6, 119, 103, 87, 71, 55, 39, 23, 7};
+
+/* Interleaves bytes 0-31 of two registers: 2 * ii + jj <- ii + 64 * jj. */
+static const uint8_t BSHUF_INTERLEAVE_BYTES[64] = {
+        0, 64, 1, 65, 2, 66, 3, 67, 4, 68, 5, 69, 6, 70, 7, 71,
+        8, 72, 9, 73, 10, 74, 11, 75, 12, 76, 13, 77, 14, 78, 15, 79,
+        16, 80, 17, 81, 18, 82, 19, 83, 20, 84, 21, 85, 22, 86, 23, 87,
+        24, 88, 25, 89, 26, 90, 27, 91, 28, 92, 29, 93, 30, 94, 31, 95};
+
+/* Interleaves words 0-15 of two registers: 2 * ii + jj <- ii + 32 * jj. */
+static const uint16_t BSHUF_INTERLEAVE_WORDS[32] = {
+        0, 32, 1, 33, 2, 34, 3, 35, 4, 36, 5, 37, 6, 38, 7, 39,
+        8, 40, 9, 41, 10, 42, 11, 43, 12, 44, 13, 45, 14, 46, 15, 47};
+
+
+/* Untranspose 16 bytes of 8 consecutive bit rows, nbyte_row bytes apart, into
+ * one byte of each of the 128 elements they cover. Bytes of elements 0-63 are
+ * returned in *lo*, of elements 64-127 in *hi*. */
+BSHUF_TARGET_AVX512
+static inline void bshuf_untrans_bit_rows_AVX512(const char* in_b,
+        const size_t nbyte_row, __m512i* lo, __m512i* hi) {
+
+    // Byte kk of the matrix operand selects output bit kk.
+    const __m512i identity = _mm512_set1_epi64(0x8040201008040201LL);
+    __m512i rows0, rows1, gather;
+
+    rows0 = _mm512_castsi128_si512(_mm_loadu_si128((__m128i *) in_b));
+    rows1 = _mm512_castsi128_si512(
+            _mm_loadu_si128((__m128i *) &in_b[4 * nbyte_row]));
+    rows0 = _mm512_inserti32x4(rows0,
+            _mm_loadu_si128((__m128i *) &in_b[1 * nbyte_row]), 1);
+    rows1 = _mm512_inserti32x4(rows1,
+            _mm_loadu_si128((__m128i *) &in_b[5 * nbyte_row]), 1);
+    rows0 = _mm512_inserti32x4(rows0,
+            _mm_loadu_si128((__m128i *) &in_b[2 * nbyte_row]), 2);
+    rows1 = _mm512_inserti32x4(rows1,
+            _mm_loadu_si128((__m128i *) &in_b[6 * nbyte_row]), 2);
+    rows0 = _mm512_inserti32x4(rows0,
+            _mm_loadu_si128((__m128i *) &in_b[3 * nbyte_row]), 3);
+    rows1 = _mm512_inserti32x4(rows1,
+            _mm_loadu_si128((__m128i *) &in_b[7 * nbyte_row]), 3);
+
+    gather = _mm512_loadu_si512(BSHUF_GATHER_ROWS);
+    *lo = _mm512_gf2p8affine_epi64_epi8(identity,
+            _mm512_permutex2var_epi8(rows0, gather, rows1), 0);
+    gather = _mm512_add_epi8(gather, _mm512_set1_epi8(8));
+    *hi = _mm512_gf2p8affine_epi64_epi8(identity,
+            _mm512_permutex2var_epi8(rows0, gather, rows1), 0);
+}
+
+
+/* Interleave byte 0 and byte 1 of 64 elements into 128 bytes. */
+BSHUF_TARGET_AVX512
+static inline void bshuf_store_elem_2_AVX512(char* out_b, __m512i byte0,
+        __m512i byte1) {
+
+    const __m512i bytes_lo = _mm512_loadu_si512(BSHUF_INTERLEAVE_BYTES);
+    const __m512i bytes_hi = _mm512_add_epi8(bytes_lo, _mm512_set1_epi8(32));
+
+    _mm512_storeu_si512(out_b,
+            _mm512_permutex2var_epi8(byte0, bytes_lo, byte1));
+    _mm512_storeu_si512(&out_b[64],
+            _mm512_permutex2var_epi8(byte0, bytes_hi, byte1));
+}
+
+
+/* Interleave bytes 0-3 of 64 elements into 256 bytes. */
+BSHUF_TARGET_AVX512
+static inline void bshuf_store_elem_4_AVX512(char* out_b, __m512i byte0,
+        __m512i byte1, __m512i byte2, __m512i byte3) {
+
+    const __m512i bytes_lo = _mm512_loadu_si512(BSHUF_INTERLEAVE_BYTES);
+    const __m512i bytes_hi = _mm512_add_epi8(bytes_lo, _mm512_set1_epi8(32));
+    const __m512i words_lo = _mm512_loadu_si512(BSHUF_INTERLEAVE_WORDS);
+    const __m512i words_hi = _mm512_add_epi16(words_lo, _mm512_set1_epi16(16));
+    __m512i low01, high01, low23, high23;
+
+    // 16 bit words of elements 0-31 and 32-63
+    low01 = _mm512_permutex2var_epi8(byte0, bytes_lo, byte1);
+    high01 = _mm512_permutex2var_epi8(byte0, bytes_hi, byte1);
+    low23 = _mm512_permutex2var_epi8(byte2, bytes_lo, byte3);
+    high23 = _mm512_permutex2var_epi8(byte2, bytes_hi, byte3);
+
+    _mm512_storeu_si512(out_b,
+            _mm512_permutex2var_epi16(low01, words_lo, low23));
+    _mm512_storeu_si512(&out_b[64],
+            _mm512_permutex2var_epi16(low01, words_hi, low23));
+    _mm512_storeu_si512(&out_b[128],
+            _mm512_permutex2var_epi16(high01, words_lo, high23));
+    _mm512_storeu_si512(&out_b[192],
+            _mm512_permutex2var_epi16(high01, words_hi, high23));
+}
+
+
+/* Untranspose bits within elements. Other element sizes than 1, 2 and 4 use
+ * the AVX2 routine. */
+BSHUF_TARGET_AVX512
+int64_t bshuf_untrans_bit_elem_AVX512(void* in, void* out, const size_t size,
+         const size_t elem_size) {
+
+    const char* in_b = (const char*) in;
+    char* out_b = (char*) out;
+    size_t nbyte_row = size / 8;
+    __m512i lo[4], hi[4];
+    size_t ii;
+
+    CHECK_MULT_EIGHT(size);
+
+    if (elem_size != 1 && elem_size != 2 && elem_size != 4) {
+        return bshuf_untrans_bit_elem_AVX(in, out, size, elem_size);
+    }
+
+    for (ii = 0; ii + 15 < nbyte_row; ii += 16) {
+        char* out_ii = &out_b[ii * 8 * elem_size];
+        for (size_t jj = 0; jj < elem_size; jj++) {
+            bshuf_untrans_bit_rows_AVX512(&in_b[jj * 8 * nbyte_row + ii],
+                    nbyte_row, &lo[jj], &hi[jj]);
+        }
+        switch (elem_size) {
+        case 1:
+            _mm512_storeu_si512(out_ii, lo[0]);
+            _mm512_storeu_si512(&out_ii[64], hi[0]);
+            break;
+        case 2:
+            bshuf_store_elem_2_AVX512(out_ii, lo[0], lo[1]);
+            bshuf_store_elem_2_AVX512(&out_ii[128], hi[0], hi[1]);
+            break;
+        default:
+            bshuf_store_elem_4_AVX512(out_ii, lo[0], lo[1], lo[2], lo[3]);
+            bshuf_store_elem_4_AVX512(&out_ii[256], hi[0], hi[1], hi[2],
+                    hi[3]);
+        }
+    }
+    bshuf_untrans_bit_elem_remainder(in_b, out_b, nbyte_row, ii, elem_size);
+    return size * elem_size;
+}
+
+#else // #ifdef USEAVX512
+
+int64_t bshuf_untrans_bit_elem_AVX512(void* in, void* out, const size_t size,
+         const size_t elem_size) {
+    return -13;
+}
+
+#endif // #ifdef USEAVX512
+
+
+/* ---- Drivers selecting the best instruction set. ---- */
 
 int64_t bshuf_trans_bit_elem(void* in, void* out, const size_t size, 
         const size_t elem_size) {
 
-    int64_t count;
+    switch (bshuf_simd_level()) {
 #ifdef USEAVX2
-    count = bshuf_trans_bit_elem_AVX(in, out, size, elem_size);
-#elif defined(USESSE2)
-    count = bshuf_trans_bit_elem_SSE(in, out, size, elem_size);
-#else
-    count = bshuf_trans_bit_elem_scal(in, out, size, elem_size);
+    case BSHUF_AVX512:
+    case BSHUF_AVX2:
+        return bshuf_trans_bit_elem_AVX(in, out, size, elem_size);
 #endif
-    return count;
+#ifdef USESSE2
+    case BSHUF_SSE2:
+        return bshuf_trans_bit_elem_SSE(in, out, size, elem_size);
+#endif
+    default:
+        return bshuf_trans_bit_elem_scal(in, out, size, elem_size);
+    }
 }
 
 
 int64_t bshuf_untrans_bit_elem(void* in, void* out, const size_t size, 
         const size_t elem_size) {
 
-    int64_t count;
+    switch (bshuf_simd_level()) {
+#ifdef USEAVX512
+    case BSHUF_AVX512:
+        return bshuf_untrans_bit_elem_AVX512(in, out, size, elem_size);
+#endif
 #ifdef USEAVX2
-    count = bshuf_untrans_bit_elem_AVX(in, out, size, elem_size);
-#elif defined(USESSE2)
-    count = bshuf_untrans_bit_elem_SSE(in, out, size, elem_size);
-#else
-    count = bshuf_untrans_bit_elem_scal(in, out, size, elem_size);
+    case BSHUF_AVX2:
+        return bshuf_untrans_bit_elem_AVX(in, out, size, elem_size);
 #endif
-    return count;
+#ifdef USESSE2
+    case BSHUF_SSE2:
+        return bshuf_untrans_bit_elem_SSE(in, out, size, elem_size);
+#endif
+    default:
+        return bshuf_untrans_bit_elem_scal(in, out, size, elem_size);
+    }
 }
 
 
@@ -1276,11 +1580,38 @@ int64_t bshuf_compress_lz4_block(ioc_chain *C_ptr,
 }
 
 
+/* Decompress and bitunshuffle a single block using a caller supplied buffer
+ * of size * elem_size bytes for the LZ4 output. */
+int64_t bshuf_decompress_lz4_block_with_buffer(const void* in, void* out,
+        void* tmp_buf, const size_t size, const size_t elem_size) {
+
+    int64_t nbytes, count;
+
+    int32_t nbytes_from_header = bshuf_read_uint32_BE(in);
+
+#ifdef BSHUF_LZ4_DECOMPRESS_FAST
+    nbytes = LZ4_decompress_fast((const char*) in + 4, tmp_buf,
+                                 size * elem_size);
+    if (nbytes < 0) return nbytes - 1000;
+    if (nbytes != nbytes_from_header) return -91;
+#else
+    nbytes = LZ4_decompress_safe((const char*) in + 4, tmp_buf,
+                                 nbytes_from_header, size * elem_size);
+    if (nbytes < 0) return nbytes - 1000;
+    if (nbytes != size * elem_size) return -91;
+    nbytes = nbytes_from_header;
+#endif
+    count = bshuf_untrans_bit_elem(tmp_buf, out, size, elem_size);
+    CHECK_ERR(count);
+    return nbytes + 4;
+}
+
+
 /* Decompress and bitunshuffle a single block. */
 int64_t bshuf_decompress_lz4_block(ioc_chain *C_ptr,
         const size_t size, const size_t elem_size) {
 
-    int64_t nbytes, count;
+    int64_t nbytes;
 
     size_t this_iter;
     void *in = ioc_get_in(C_ptr, &this_iter);
@@ -1295,27 +1626,8 @@ int64_t bshuf_decompress_lz4_block(ioc_chain *C_ptr,
     void* tmp_buf = malloc(size * elem_size);
     if (tmp_buf == NULL) return -1;
 
-#ifdef BSHUF_LZ4_DECOMPRESS_FAST
-    nbytes = LZ4_decompress_fast((char*) in + 4, tmp_buf, size * elem_size);
-    CHECK_ERR_FREE_LZ(nbytes, tmp_buf);
-    if (nbytes != nbytes_from_header) {
-        free(tmp_buf);
-        return -91;
-    }
-#else
-    nbytes = LZ4_decompress_safe((char*) in + 4, tmp_buf, nbytes_from_header,
-                                 size * elem_size);
-    CHECK_ERR_FREE_LZ(nbytes, tmp_buf);
-    if (nbytes != size * elem_size) {
-        free(tmp_buf);
-        return -91;
-    }
-    nbytes = nbytes_from_header;
-#endif
-    count = bshuf_untrans_bit_elem(tmp_buf, out, size, elem_size);
-    CHECK_ERR_FREE(count, tmp_buf);
-    nbytes += 4;
-
+    nbytes = bshuf_decompress_lz4_block_with_buffer(in, out, tmp_buf, size,
+                                                    elem_size);
     free(tmp_buf);
     return nbytes;
 }
@@ -1401,3 +1713,8 @@ int64_t bshuf_decompress_lz4(const void* in, void* out, const size_t size,
 
 #undef USESSE2
 #undef USEAVX2
+#undef BSHUF_RUNTIME_DISPATCH
+#undef BSHUF_TARGET_SSE2
+#undef BSHUF_TARGET_AVX2
+#undef USEAVX512
+#undef BSHUF_TARGET_AVX512
@@ -18,6 +18,7 @@
  *      -1    : Failed to allocate memory.
  *      -11   : Missing SSE.
  *      -12   : Missing AVX.
+ *      -13   : Missing AVX-512.
  *      -80   : Input size not a multiple of 8.
  *      -81   : block_size not multiple of 8.
  *      -91   : Decompression error, wrong number of bytes processed.
@@ -50,7 +51,7 @@ extern "C" {
 
 /* --- bshuf_using_SSE2 ----
  *
- * Whether routines where compiled with the SSE2 instruction set.
+ * Whether the SSE2 routines are used on this CPU.
  *
  * Returns
  * -------
@@ -62,7 +63,7 @@ int bshuf_using_SSE2(void);
 
 /* ---- bshuf_using_AVX2 ----
  *
- * Whether routines where compiled with the AVX2 instruction set.
+ * Whether the AVX2 routines are used on this CPU.
  *
  * Returns
  * -------
@@ -72,6 +73,43 @@ int bshuf_using_SSE2(void);
 int bshuf_using_AVX2(void);
 
 
+/* ---- bshuf_using_AVX512 ----
+ *
+ * Whether the AVX-512 routines (AVX-512BW, AVX-512VBMI and GFNI) are used on
+ * this CPU.
+ *
+ * Returns
+ * -------
+ *  1 if using AVX-512, 0 otherwise.
+ *
+ */
+int bshuf_using_AVX512(void);
+
+
+/* ---- bshuf_untrans_bit_elem_scal, bshuf_untrans_bit_elem_AVX512 ----
+ *
+ * Undo the bit transpose of bshuf_trans_bit_elem with a specific instruction
+ * set, for testing. bshuf_untrans_bit_elem_AVX512 may only be called if
+ * bshuf_using_AVX512() returns 1.
+ *
+ * Parameters
+ * ----------
+ *  in : input buffer, must be of size * elem_size bytes
+ *  out : output buffer, must be of size * elem_size bytes
+ *  size : number of elements in input, must be a multiple of 8
+ *  elem_size : element size of typed data
+ *
+ * Returns
+ * -------
+ *  number of bytes processed, negative error-code if failed.
+ *
+ */
+int64_t bshuf_untrans_bit_elem_scal(void* in, void* out, const size_t size,
+        const size_t elem_size);
+int64_t bshuf_untrans_bit_elem_AVX512(void* in, void* out, const size_t size,
+        const size_t elem_size);
+
+
 /* ---- bshuf_default_block_size ----
  *
  * The default block size as function of element size.
@@ -225,6 +263,29 @@ int64_t bshuf_compress_lz4(const void* in, void* out, const size_t size, const s
 int64_t bshuf_decompress_lz4(const void* in, void* out, const size_t size,
         const size_t elem_size, size_t block_size);
 
+
+/* ---- bshuf_decompress_lz4_block_with_buffer ----
+ *
+ * Undo compression and bitshuffling of a single block as written by
+ * *bshuf_compress_lz4*, i.e. a 4 byte compressed size followed by the LZ4
+ * data. Allows the caller to process the data block by block.
+ *
+ * Parameters
+ * ----------
+ *  in : input buffer, pointing to the start of the block
+ *  out : output buffer, must be of size * elem_size bytes
+ *  tmp_buf : scratch buffer, must be of size * elem_size bytes
+ *  size : number of elements in the block, must be a multiple of 8
+ *  elem_size : element size of typed data
+ *
+ * Returns
+ * -------
+ *  number of bytes consumed in *input* buffer, negative error-code if failed.
+ *
+ */
+int64_t bshuf_decompress_lz4_block_with_buffer(const void* in, void* out,
+        void* tmp_buf, const size_t size, const size_t elem_size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,11 +4,13 @@
 #include <dectris/neggia/compression_algorithms/bitshuffle.h>
 #include <dectris/neggia/compression_algorithms/lz4.h>
 #include <string.h>
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
 
 #ifndef INT32_MAX
 #define INT32_MAX 0x7fffffffL  /// 2GB
@@ -30,8 +32,11 @@
 
 namespace {
 // set inBuffer to inBuffer + 12 and outBufferSize to decompressed Size. Read
-// blockSize from data
-void readLz4Header(const char*& inBuffer, size_t& outSize, size_t& blockSize) {
+// blockSize from data. Bitshuffle uses its default block size if blockSize
+// is zero.
+void readBshufLz4Header(const char*& inBuffer,
+                        size_t& outSize,
+                        size_t& blockSize) {
     const uint64_t* const i64Buf = (uint64_t*)inBuffer;
     const uint64_t origSize =
             (uint64_t)(be64toht(*i64Buf));  // is saved in be format
@@ -43,6 +48,218 @@ void readLz4Header(const char*& inBuffer, size_t& outSize, size_t& blockSize) {
     blockSize = (uint32_t)(be32toht(*i32Buf));
     inBuffer += 4;
 }
+
+// Like readBshufLz4Header. LZ4 data of a non-zero size must have a non-zero
+// block size, otherwise decoding it would never end.
+void readLz4Header(const char*& inBuffer, size_t& outSize, size_t& blockSize) {
+    readBshufLz4Header(inBuffer, outSize, blockSize);
+    if (blockSize == 0 && outSize > 0)
+        throw std::runtime_error("DCompression: block size is zero");
+}
+
+// Decodes the LZ4 block at inBuffer, which starts with its compressed size,
+// into outBuffer. Returns the decoded data, which points into inBuffer if the
+// block is stored uncompressed.
+const char* decodeLz4Block(const char* inBuffer,
+                           char* outBuffer,
+                           size_t blockSize) {
+    uint32_t compressedBlockSize = be32toht(*(const uint32_t*)inBuffer);
+    inBuffer += 4;
+    if (compressedBlockSize == blockSize)  // there was no compression
+        return inBuffer;
+    int compressedBytes = LZ4_decompress_fast(inBuffer, outBuffer, blockSize);
+    if (compressedBytes != (int)compressedBlockSize) {
+        std::ostringstream failureStr;
+        failureStr << "DCompression: Decompressed size of "
+                   << compressedBlockSize << " bytes expected. Got "
+                   << compressedBytes << " bytes." << std::endl;
+        throw std::runtime_error(failureStr.str());
+    }
+    return outBuffer;
+}
+
+// Compressed blocks of LZ4 data. Block i holds the bytes
+// [i * blockSize, min((i + 1) * blockSize, size)).
+struct Lz4Blocks {
+    size_t size;
+    size_t blockSize;
+    std::vector<const char*> blocks;
+};
+
+Lz4Blocks findLz4Blocks(const char* inBuffer, size_t& outBufferSize) {
+    Lz4Blocks result;
+    readLz4Header(inBuffer, outBufferSize, result.blockSize);
+    result.size = outBufferSize;
+    if (result.blockSize > result.size)
+        result.blockSize = result.size;
+    for (size_t offset = 0; offset < result.size; offset += result.blockSize) {
+        result.blocks.push_back(inBuffer);
+        inBuffer += 4 + be32toht(*(const uint32_t*)inBuffer);
+    }
+    return result;
+}
+
+// Indices of the blocks of blockSize bytes of the first size bytes for
+// which isBlockNeeded returns true, or of all blocks if it is not set
+std::vector<size_t> findNeededBlocks(size_t numberOfBlocks,
+                                     size_t blockSize,
+                                     size_t size,
+                                     const DecodedBlockFilter& isBlockNeeded) {
+    std::vector<size_t> neededBlocks;
+    neededBlocks.reserve(numberOfBlocks);
+    for (size_t i = 0; i < numberOfBlocks; ++i) {
+        size_t offset = i * blockSize;
+        if (!isBlockNeeded ||
+            isBlockNeeded(offset, std::min(blockSize, size - offset)))
+        {
+            neededBlocks.push_back(i);
+        }
+    }
+    return neededBlocks;
+}
+
+// Runs the tasks with parallelFor, or one after the other on the calling
+// thread if it is not set
+void runTasks(size_t numberOfTasks,
+              const ParallelFor& parallelFor,
+              const std::function<void(size_t)>& task) {
+    if (parallelFor) {
+        parallelFor(numberOfTasks, task);
+    } else {
+        for (size_t i = 0; i < numberOfTasks; ++i)
+            task(i);
+    }
+}
+
+// Each task decodes at least this many bytes, data written with a large
+// block size has one block per task.
+constexpr size_t LZ4_BYTES_PER_TASK = 128 << 10;
+
+// Decodes the needed blocks into outBuffer if it is set and otherwise into a
+// buffer of the task which is passed to blockCallback.
+void decodeLz4Blocks(const Lz4Blocks& blocks,
+                     char* outBuffer,
+                     const DecodedBlockFilter& isBlockNeeded,
+                     const DecodedBlockCallback& blockCallback,
+                     const ParallelFor& parallelFor) {
+    // empty data may have a block size of zero
+    if (blocks.size == 0)
+        return;
+    std::vector<size_t> neededBlocks =
+            findNeededBlocks(blocks.blocks.size(), blocks.blockSize,
+                             blocks.size, isBlockNeeded);
+    size_t blocksPerTask = 1;
+    if (blocks.blockSize < LZ4_BYTES_PER_TASK)
+        blocksPerTask = LZ4_BYTES_PER_TASK / blocks.blockSize;
+    size_t numberOfTasks =
+            (neededBlocks.size() + blocksPerTask - 1) / blocksPerTask;
+    runTasks(numberOfTasks, parallelFor, [&](size_t task) {
+        std::vector<char> buffer(outBuffer ? 0 : blocks.blockSize);
+        size_t end = std::min((task + 1) * blocksPerTask, neededBlocks.size());
+        for (size_t j = task * blocksPerTask; j < end; ++j) {
+            size_t i = neededBlocks[j];
+            size_t offset = i * blocks.blockSize;
+            size_t blockSize = std::min(blocks.blockSize, blocks.size - offset);
+            char* out = outBuffer ? outBuffer + offset : buffer.data();
+            const char* decoded =
+                    decodeLz4Block(blocks.blocks[i], out, blockSize);
+            if (!outBuffer)
+                blockCallback(decoded, offset, blockSize);
+            else if (decoded != out)
+                memcpy(out, decoded, blockSize);
+        }
+    });
+}
+
+void throwBitshuffleError(int64_t err) {
+    std::stringstream errStream;
+    errStream << "bitshuffle returned with error code: " << err;
+    throw std::runtime_error(errStream.str());
+}
+
+// Compressed blocks of bitshuffle/LZ4 data. Block i holds the elements
+// [i * blockElements, min((i + 1) * blockElements, compressedElements)).
+struct BshufLz4Blocks {
+    size_t size;
+    size_t elementSize;
+    size_t blockElements;
+    size_t compressedElements;
+    std::vector<const char*> blocks;
+    // the last (size % 8) elements are stored uncompressed
+    const char* uncompressedElements;
+};
+
+// Every block starts with its compressed size, so the blocks can be found
+// without decoding them.
+BshufLz4Blocks findBshufLz4Blocks(const char* inBuffer,
+                                  size_t& outBufferSize,
+                                  size_t elementSize) {
+    size_t blockSize;
+    readBshufLz4Header(inBuffer, outBufferSize, blockSize);
+    if (outBufferSize % elementSize)
+        throw std::runtime_error("Non integer number of elements");
+    BshufLz4Blocks result;
+    result.size = outBufferSize / elementSize;
+    result.elementSize = elementSize;
+    result.blockElements = blockSize / elementSize;
+    if (result.blockElements == 0)
+        result.blockElements = bshuf_default_block_size(elementSize);
+    if (result.blockElements % 8)
+        throwBitshuffleError(-81);
+    result.compressedElements = result.size - result.size % 8;
+    for (size_t element = 0; element < result.compressedElements;
+         element += result.blockElements)
+    {
+        result.blocks.push_back(inBuffer);
+        inBuffer += 4 + be32toht(*(const uint32_t*)inBuffer);
+    }
+    result.uncompressedElements = inBuffer;
+    return result;
+}
+
+// Blocks are decoded in groups, so that each task allocates its scratch
+// space once and does enough work to outweigh the scheduling.
+constexpr size_t BSHUF_BLOCKS_PER_TASK = 16;
+
+// Decodes the needed blocks into outBuffer if it is set and otherwise into a
+// buffer of the task which is passed to blockCallback.
+void decodeBshufLz4Blocks(const BshufLz4Blocks& blocks,
+                          char* outBuffer,
+                          const DecodedBlockFilter& isBlockNeeded,
+                          const DecodedBlockCallback& blockCallback,
+                          const ParallelFor& parallelFor) {
+    size_t elementSize = blocks.elementSize;
+    std::vector<size_t> neededBlocks = findNeededBlocks(
+            blocks.blocks.size(), blocks.blockElements * elementSize,
+            blocks.compressedElements * elementSize, isBlockNeeded);
+    size_t numberOfTasks =
+            (neededBlocks.size() + BSHUF_BLOCKS_PER_TASK - 1) /
+            BSHUF_BLOCKS_PER_TASK;
+    runTasks(numberOfTasks, parallelFor, [&](size_t task) {
+        size_t bufferElements =
+                std::min(blocks.blockElements, blocks.compressedElements);
+        std::vector<char> buffer((outBuffer ? 1 : 2) * bufferElements *
+                                 elementSize);
+        char* scratch = buffer.data();
+        char* block =
+                outBuffer ? nullptr : scratch + bufferElements * elementSize;
+        size_t end = std::min((task + 1) * BSHUF_BLOCKS_PER_TASK,
+                              neededBlocks.size());
+        for (size_t j = task * BSHUF_BLOCKS_PER_TASK; j < end; ++j) {
+            size_t i = neededBlocks[j];
+            size_t element = i * blocks.blockElements;
+            size_t count = std::min(blocks.blockElements,
+                                    blocks.compressedElements - element);
+            char* out = outBuffer ? outBuffer + element * elementSize : block;
+            int64_t consumed = bshuf_decompress_lz4_block_with_buffer(
+                    blocks.blocks[i], out, scratch, count, elementSize);
+            if (consumed < 0)
+                throwBitshuffleError(consumed);
+            if (!outBuffer)
+                blockCallback(out, element * elementSize, count * elementSize);
+        }
+    });
+}
 }  // namespace
 
 void lz4Decode(const char* inBuffer, char* outBuffer, size_t& outBufferSize) {
@@ -59,28 +276,12 @@ void lz4Decode(const char* inBuffer, char* outBuffer, size_t& outBufferSize) {
         if (outBufferSize - decompSize <
             blockSize)  // the last block can be smaller than blockSize.
             blockSize = outBufferSize - decompSize;
-        const uint32_t* i32Buf = (const uint32_t*)inBuffer;
-        uint32_t compressedBlockSize =
-                be32toht(*i32Buf);  // is saved in be format
-        inBuffer += 4;
-        if (compressedBlockSize == blockSize)  // there was no compression
-        {
-            memcpy(outBuffer, inBuffer, blockSize);
-        } else  // do the decompression
-        {
-            int compressedBytes =
-                    LZ4_decompress_fast(inBuffer, outBuffer, blockSize);
-            if (compressedBytes != (int)compressedBlockSize) {
-                std::ostringstream failureStr;
-                failureStr << "DCompression: Decompressed size of "
-                           << compressedBlockSize << " bytes expected. Got "
-                           << compressedBytes << " bytes." << std::endl;
-                throw std::runtime_error(failureStr.str());
-            }
-        }
-        inBuffer += compressedBlockSize; /* advance the read pointer to the next
-                                            block */
-        outBuffer += blockSize;          /* advance the write pointer */
+        const char* decoded = decodeLz4Block(inBuffer, outBuffer, blockSize);
+        if (decoded != outBuffer)
+            memcpy(outBuffer, decoded, blockSize);
+        // advance the read pointer to the next block
+        inBuffer += 4 + be32toht(*(const uint32_t*)inBuffer);
+        outBuffer += blockSize; /* advance the write pointer */
         decompSize += blockSize;
     }
 }
@@ -90,15 +291,156 @@ void bshufUncompressLz4(const char* inBuffer,
                         size_t& outBufferSize,
                         size_t elementSize) {
     size_t blockSize;
-    readLz4Header(inBuffer, outBufferSize, blockSize);
+    readBshufLz4Header(inBuffer, outBufferSize, blockSize);
     if (outBufferSize % elementSize)
         throw std::runtime_error("Non integer number of elements");
     int64_t err = bshuf_decompress_lz4(inBuffer, outBuffer,
                                        outBufferSize / elementSize, elementSize,
                                        blockSize / elementSize);
-    if (err < 0) {
-        std::stringstream errStream;
-        errStream << "bitshuffle returned with error code: " << err;
-        throw std::runtime_error(errStream.str());
+    if (err < 0)
+        throwBitshuffleError(err);
+}
+
+void lz4DecodeBlocks(const char* inBuffer,
+                     size_t& outBufferSize,
+                     size_t elementSize,
+                     const DecodedBlockCallback& blockCallback) {
+    size_t blockSize = 0;
+    const char* compressedData = inBuffer;
+    readLz4Header(inBuffer, outBufferSize, blockSize);
+    if (blockSize > outBufferSize)
+        blockSize = outBufferSize;
+    if (outBufferSize == 0 || blockSize % elementSize) {
+        // blocks would split elements, decode everything at once
+        std::vector<char> buffer(outBufferSize);
+        lz4Decode(compressedData, buffer.data(), outBufferSize);
+        blockCallback(buffer.data(), 0, outBufferSize);
+        return;
+    }
+
+    std::vector<char> buffer(blockSize);
+    size_t decompSize = 0;
+    while (decompSize < outBufferSize) {
+        if (outBufferSize - decompSize < blockSize)
+            blockSize = outBufferSize - decompSize;
+        blockCallback(decodeLz4Block(inBuffer, buffer.data(), blockSize),
+                      decompSize, blockSize);
+        inBuffer += 4 + be32toht(*(const uint32_t*)inBuffer);
+        decompSize += blockSize;
+    }
+}
+
+void bshufUncompressLz4Blocks(const char* inBuffer,
+                              size_t& outBufferSize,
+                              size_t elementSize,
+                              const DecodedBlockCallback& blockCallback) {
+    size_t blockSize;
+    readBshufLz4Header(inBuffer, outBufferSize, blockSize);
+    if (outBufferSize % elementSize)
+        throw std::runtime_error("Non integer number of elements");
+    size_t size = outBufferSize / elementSize;
+    size_t blockElements = blockSize / elementSize;
+    if (blockElements == 0)
+        blockElements = bshuf_default_block_size(elementSize);
+    if (blockElements % 8)
+        throwBitshuffleError(-81);
+
+    // decoded block and scratch space for the LZ4 output
+    size_t bufferElements = std::min(blockElements, size);
+    std::vector<char> buffer(2 * bufferElements * elementSize);
+    char* block = buffer.data();
+    char* scratch = block + bufferElements * elementSize;
+    size_t element = 0;
+    while (size - element >= 8) {
+        size_t count = std::min(blockElements, size - element);
+        count -= count % 8;
+        int64_t consumed = bshuf_decompress_lz4_block_with_buffer(
+                inBuffer, block, scratch, count, elementSize);
+        if (consumed < 0)
+            throwBitshuffleError(consumed);
+        blockCallback(block, element * elementSize, count * elementSize);
+        inBuffer += consumed;
+        element += count;
+    }
+    // the last (size % 8) elements are stored uncompressed
+    if (element < size) {
+        blockCallback(inBuffer, element * elementSize,
+                      (size - element) * elementSize);
     }
 }
+
+void bshufUncompressLz4(const char* inBuffer,
+                        char* outBuffer,
+                        size_t& outBufferSize,
+                        size_t elementSize,
+                        const ParallelFor& parallelFor) {
+    BshufLz4Blocks blocks =
+            findBshufLz4Blocks(inBuffer, outBufferSize, elementSize);
+    decodeBshufLz4Blocks(blocks, outBuffer, DecodedBlockFilter(),
+                         DecodedBlockCallback(), parallelFor);
+    memcpy(outBuffer + blocks.compressedElements * elementSize,
+           blocks.uncompressedElements,
+           (blocks.size - blocks.compressedElements) * elementSize);
+}
+
+void bshufUncompressLz4Blocks(const char* inBuffer,
+                              size_t& outBufferSize,
+                              size_t elementSize,
+                              const DecodedBlockCallback& blockCallback,
+                              const ParallelFor& parallelFor) {
+    bshufUncompressLz4Blocks(inBuffer, outBufferSize, elementSize,
+                             DecodedBlockFilter(), blockCallback, parallelFor);
+}
+
+void lz4Decode(const char* inBuffer,
+               char* outBuffer,
+               size_t& outBufferSize,
+               const ParallelFor& parallelFor) {
+    Lz4Blocks blocks = findLz4Blocks(inBuffer, outBufferSize);
+    decodeLz4Blocks(blocks, outBuffer, DecodedBlockFilter(),
+                    DecodedBlockCallback(), parallelFor);
+}
+
+void lz4DecodeBlocks(const char* inBuffer,
+                     size_t& outBufferSize,
+                     size_t elementSize,
+                     const DecodedBlockCallback& blockCallback,
+                     const ParallelFor& parallelFor) {
+    lz4DecodeBlocks(inBuffer, outBufferSize, elementSize,
+                    DecodedBlockFilter(), blockCallback, parallelFor);
+}
+
+void lz4DecodeBlocks(const char* inBuffer,
+                     size_t& outBufferSize,
+                     size_t elementSize,
+                     const DecodedBlockFilter& isBlockNeeded,
+                     const DecodedBlockCallback& blockCallback,
+                     const ParallelFor& parallelFor) {
+    Lz4Blocks blocks = findLz4Blocks(inBuffer, outBufferSize);
+    if (blocks.blockSize % elementSize) {
+        // blocks would split elements, decode everything at once
+        std::vector<char> buffer(outBufferSize);
+        decodeLz4Blocks(blocks, buffer.data(), DecodedBlockFilter(),
+                        DecodedBlockCallback(), parallelFor);
+        blockCallback(buffer.data(), 0, outBufferSize);
+        return;
+    }
+    decodeLz4Blocks(blocks, nullptr, isBlockNeeded, blockCallback,
+                    parallelFor);
+}
+
+void bshufUncompressLz4Blocks(const char* inBuffer,
+                              size_t& outBufferSize,
+                              size_t elementSize,
+                              const DecodedBlockFilter& isBlockNeeded,
+                              const DecodedBlockCallback& blockCallback,
+                              const ParallelFor& parallelFor) {
+    BshufLz4Blocks blocks =
+            findBshufLz4Blocks(inBuffer, outBufferSize, elementSize);
+    decodeBshufLz4Blocks(blocks, nullptr, isBlockNeeded, blockCallback,
+                         parallelFor);
+    size_t offset = blocks.compressedElements * elementSize;
+    size_t size = (blocks.size - blocks.compressedElements) * elementSize;
+    if (size > 0 && (!isBlockNeeded || isBlockNeeded(offset, size)))
+        blockCallback(blocks.uncompressedElements, offset, size);
+}
@@ -3,6 +3,7 @@
 #ifndef DECODE_H
 #define DECODE_H
 #include <cstdlib>
+#include <functional>
 
 #define LZ4_FILTER 32004
 #define BSHUF_H5FILTER 32008
@@ -14,4 +15,70 @@ void bshufUncompressLz4(const char* inBuffer,
                         size_t& outBufferSize,
                         size_t elementSize);
 
+// Called for consecutive pieces of the decoded data with their address,
+// offset and size in bytes. Offset and size are multiples of the element
+// size. The data is only valid during the call.
+typedef std::function<void(const char*, size_t, size_t)> DecodedBlockCallback;
+
+// Like lz4Decode and bshufUncompressLz4, but pass the data block by block to
+// blockCallback instead of writing it to an output buffer.
+void lz4DecodeBlocks(const char* inBuffer,
+                     size_t& outBufferSize,
+                     size_t elementSize,
+                     const DecodedBlockCallback& blockCallback);
+void bshufUncompressLz4Blocks(const char* inBuffer,
+                              size_t& outBufferSize,
+                              size_t elementSize,
+                              const DecodedBlockCallback& blockCallback);
+
+// Runs task(0) to task(numberOfTasks - 1), possibly concurrently, and returns
+// when all of them have finished, e.g. ThreadPool::parallelFor.
+typedef std::function<void(size_t, const std::function<void(size_t)>&)>
+        ParallelFor;
+
+// Like lz4Decode, lz4DecodeBlocks, bshufUncompressLz4 and
+// bshufUncompressLz4Blocks, but find the compressed blocks first and decode
+// them concurrently with parallelFor. blockCallback is called concurrently for
+// different blocks.
+void lz4Decode(const char* inBuffer,
+               char* outBuffer,
+               size_t& outBufferSize,
+               const ParallelFor& parallelFor);
+void lz4DecodeBlocks(const char* inBuffer,
+                     size_t& outBufferSize,
+                     size_t elementSize,
+                     const DecodedBlockCallback& blockCallback,
+                     const ParallelFor& parallelFor);
+void bshufUncompressLz4(const char* inBuffer,
+                        char* outBuffer,
+                        size_t& outBufferSize,
+                        size_t elementSize,
+                        const ParallelFor& parallelFor);
+void bshufUncompressLz4Blocks(const char* inBuffer,
+                              size_t& outBufferSize,
+                              size_t elementSize,
+                              const DecodedBlockCallback& blockCallback,
+                              const ParallelFor& parallelFor);
+
+// Returns whether the decoded bytes [offset, offset + size) are needed.
+typedef std::function<bool(size_t, size_t)> DecodedBlockFilter;
+
+// Like lz4DecodeBlocks and bshufUncompressLz4Blocks, but only decode the
+// blocks for which isBlockNeeded returns true. The other blocks are skipped
+// by their compressed size, e.g. to read a small region of a large frame.
+// Decodes on the calling thread if parallelFor is not set. LZ4 data whose
+// blocks would split elements is decoded completely.
+void lz4DecodeBlocks(const char* inBuffer,
+                     size_t& outBufferSize,
+                     size_t elementSize,
+                     const DecodedBlockFilter& isBlockNeeded,
+                     const DecodedBlockCallback& blockCallback,
+                     const ParallelFor& parallelFor);
+void bshufUncompressLz4Blocks(const char* inBuffer,
+                              size_t& outBufferSize,
+                              size_t elementSize,
+                              const DecodedBlockFilter& isBlockNeeded,
+                              const DecodedBlockCallback& blockCallback,
+                              const ParallelFor& parallelFor);
+
 #endif  // DECODE_H
@@ -5,7 +5,9 @@
 #include <cmath>
 #include <iostream>
 #include <map>
+#include <stdexcept>
 #include "JenkinsLookup3Checksum.h"
+#include "constants.h"
 
 H5BTreeVersion2::H5BTreeVersion2() {
     this->init();
@@ -25,42 +27,105 @@ size_t H5BTreeVersion2::getNumberOfRecords() const {
 }
 
 H5BTreeVersion2::Node H5BTreeVersion2::getRootNode() const {
-    Node rootNode(H5Object(fileAddress(), _rootNodeAddress));
-    rootNode.numberOfRecords = _numberOfRecordsInRootNode;
-    rootNode.depth = _depth;
-    return rootNode;
+    return makeNode(_rootNodeAddress, _numberOfRecordsInRootNode, _depth);
+}
+
+H5BTreeVersion2::Node H5BTreeVersion2::makeNode(size_t address,
+                                                size_t numberOfRecords,
+                                                size_t depth) const {
+    Node node(H5Object(fileAddress(), address));
+    node.numberOfRecords = numberOfRecords;
+    node.depth = depth;
+    node.childPointersOffset = 6 + _recordSize * numberOfRecords;
+    node.childPointerSize =
+            depth > 0 ? getSizeOfChildPointerMultiplet(depth) : 0;
+    return node;
 }
 
 size_t H5BTreeVersion2::getLinkAddressByName(
         const std::string& linkName) const {
+    size_t recordAddress;
+    if (!tryGetLinkAddressByName(linkName, recordAddress))
+        throw std::out_of_range("hash not found");
+    return recordAddress;
+}
+
+bool H5BTreeVersion2::tryGetLinkAddressByName(const std::string& linkName,
+                                              size_t& recordAddress) const {
     assert(_btreeType == 5);
+    if (_totalNumberOfRecords == 0)
+        return false;
     Node rootNode = getRootNode();
     uint32_t hash = JenkinsLookup3Checksum(linkName);
-    return getRecordAddressWithinInternalNodeFromLinkHash(hash, rootNode);
+    recordAddress =
+            getRecordAddressWithinInternalNodeFromLinkHash(hash, rootNode);
+    return recordAddress != H5_INVALID_ADDRESS;
+}
+
+void H5BTreeVersion2::forEachRecord(
+        const std::function<void(size_t)>& recordCallback) const {
+    if (_totalNumberOfRecords > 0)
+        forEachRecordWithinInternalNode(recordCallback, getRootNode());
+}
+
+void H5BTreeVersion2::forEachRecordWithinInternalNode(
+        const std::function<void(size_t)>& recordCallback,
+        const Node& node) const {
+    // child node i holds the records between records i - 1 and i
+    for (size_t record = 0; record <= node.numberOfRecords; ++record) {
+        if (node.depth > 0) {
+            forEachRecordWithinInternalNode(recordCallback,
+                                            getChildNode(node, record));
+        }
+        if (record < node.numberOfRecords)
+            recordCallback(node.offset() + 6 + record * _recordSize);
+    }
 }
 
 namespace {
+// chunks are sorted by their offset in the first dimension, then the second
+// and so on
 template <class T1, class T2>
 int chunkCompare(const T1* key0, const T2* key1, size_t len) {
-    for (size_t i = len; i > 0; --i) {
-        if (key0[i - 1] < key1[i - 1])
+    for (size_t i = 0; i < len; ++i) {
+        if (key0[i] < key1[i])
             return -1;
-        if (key0[i - 1] > key1[i - 1])
+        if (key0[i] > key1[i])
             return 1;
     }
     return 0;
 }
+
+// index of the first of numberOfRecords sorted records for which
+// isLess(record) is false
+template <class IsLess>
+size_t lowerBound(size_t numberOfRecords, const IsLess& isLess) {
+    size_t first = 0;
+    size_t count = numberOfRecords;
+    while (count > 0) {
+        size_t step = count / 2;
+        if (isLess(first + step)) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first;
+}
 }  // namespace
 
-size_t H5BTreeVersion2::getChunkAddressByOffset(
-        const std::vector<size_t> chunkOffset) const {
+H5ChunkRecord H5BTreeVersion2::getChunkRecordByOffset(
+        const std::vector<size_t> chunkOffset,
+        uint64_t chunkSize) const {
     switch (_btreeType) {
         case 10:
         case 11: {
-            size_t numDimensions = (_recordSize - 8) / 8;
             Node rootNode = getRootNode();
-            return getChunkAddressByOffsetWithinInternalNode(chunkOffset,
-                                                             rootNode);
+            H5Object record(fileAddress(),
+                            getChunkRecordAddressByOffsetWithinInternalNode(
+                                    chunkOffset, rootNode));
+            return readChunkRecord(record, chunkOffset.size(), chunkSize);
         }
         default:
             throw std::runtime_error("btree type " +
@@ -69,32 +134,117 @@ size_t H5BTreeVersion2::getChunkAddressByOffset(
     }
 }
 
-size_t H5BTreeVersion2::getChunkAddressByOffsetWithinInternalNode(
+size_t H5BTreeVersion2::getChunkRecordAddressByOffsetWithinInternalNode(
         const std::vector<size_t> chunkOffset,
         const Node& node) const {
-    bool found = false;
-    for (size_t record = 0; record < node.numberOfRecords; ++record) {
-        size_t recordOffset = 6 + record * _recordSize;
-        size_t chunkAddress = node.read_u64(recordOffset);
-        int compare = chunkCompare(
-                chunkOffset.data(),
-                (const uint64_t*)node.address(recordOffset + _recordSize -
-                                              chunkOffset.size() * 8),
-                chunkOffset.size());
-        if (compare < 0) {
-            if (node.depth == 0)
-                throw std::out_of_range("chunk not found");
-            return getChunkAddressByOffsetWithinInternalNode(
-                    chunkOffset, getChildNode(node, record));
+    size_t record = lowerBoundOfChunkOffset(chunkOffset, node);
+    size_t recordOffset = 6 + record * _recordSize;
+    if (record < node.numberOfRecords &&
+        chunkCompare(chunkOffset.data(),
+                     (const uint64_t*)node.address(recordOffset + _recordSize -
+                                                   chunkOffset.size() * 8),
+                     chunkOffset.size()) == 0)
+    {
+        return node.offset() + recordOffset;
+    }
+    if (node.depth == 0)
+        throw std::out_of_range("chunk not found");
+    return getChunkRecordAddressByOffsetWithinInternalNode(
+            chunkOffset, getChildNode(node, record));
+}
+
+size_t H5BTreeVersion2::lowerBoundOfChunkOffset(
+        const std::vector<size_t>& chunkOffset,
+        const Node& node) const {
+    // the scaled offset of the chunk is stored at the end of the record
+    size_t keyOffset = 6 + _recordSize - chunkOffset.size() * 8;
+    return lowerBound(node.numberOfRecords, [&](size_t record) {
+        return chunkCompare((const uint64_t*)node.address(
+                                    keyOffset + record * _recordSize),
+                            chunkOffset.data(), chunkOffset.size()) < 0;
+    });
+}
+
+void H5BTreeVersion2::forEachChunkRecord(
+        const std::vector<size_t>& firstChunkOffset,
+        uint64_t chunkSize,
+        const std::function<bool(const uint64_t*, const H5ChunkRecord&)>&
+                chunkCallback) const {
+    if (_btreeType != 10 && _btreeType != 11) {
+        throw std::runtime_error("btree type " +
+                                 std::to_string((int)_btreeType) +
+                                 " not supported to extract data chunks.");
+    }
+    if (_totalNumberOfRecords > 0) {
+        forEachChunkRecordWithinInternalNode(firstChunkOffset, chunkSize,
+                                             chunkCallback, getRootNode());
+    }
+}
+
+bool H5BTreeVersion2::forEachChunkRecordWithinInternalNode(
+        const std::vector<size_t>& firstChunkOffset,
+        uint64_t chunkSize,
+        const std::function<bool(const uint64_t*, const H5ChunkRecord&)>&
+                chunkCallback,
+        const Node& node) const {
+    const size_t rank = firstChunkOffset.size();
+    // child node i holds the chunks between records i - 1 and i, so the
+    // chunks before the first record not smaller than firstChunkOffset are
+    // skipped
+    for (size_t record = lowerBoundOfChunkOffset(firstChunkOffset, node);
+         record <= node.numberOfRecords; ++record)
+    {
+        if (node.depth > 0 &&
+            !forEachChunkRecordWithinInternalNode(firstChunkOffset, chunkSize,
+                                                  chunkCallback,
+                                                  getChildNode(node, record)))
+        {
+            return false;
         }
-        if (compare == 0) {
-            return chunkAddress;
+        if (record == node.numberOfRecords)
+            break;
+        H5Object recordObject = node.at(6 + record * _recordSize);
+        if (!chunkCallback((const uint64_t*)recordObject.address(
+                                   _recordSize - rank * 8),
+                           readChunkRecord(recordObject, rank, chunkSize)))
+        {
+            return false;
         }
     }
-    if (node.depth == 0)
-        throw std::out_of_range("hash not found");
-    return getChunkAddressByOffsetWithinInternalNode(
-            chunkOffset, getChildNode(node, node.numberOfRecords));
+    return true;
+}
+
+std::vector<H5ChunkRecord> H5BTreeVersion2::getChunkRecordsOfFrames(
+        size_t rank,
+        size_t firstFrame,
+        size_t numberOfFrames,
+        uint64_t chunkSize) const {
+    std::vector<H5ChunkRecord> records(
+            numberOfFrames,
+            H5ChunkRecord{H5ChunkRecord::UNDEFINED_ADDRESS, 0, 0});
+    if (numberOfFrames == 0)
+        return records;
+    std::vector<size_t> firstChunkOffset(rank, 0);
+    firstChunkOffset[0] = firstFrame;
+    size_t endFrame = firstFrame + numberOfFrames;
+    forEachChunkRecord(
+            firstChunkOffset, chunkSize,
+            [&](const uint64_t* chunkOffset, const H5ChunkRecord& record) {
+                if (chunkOffset[0] >= endFrame)
+                    return false;
+                records[chunkOffset[0] - firstFrame] = record;
+                return true;
+            });
+    return records;
+}
+
+H5ChunkRecord H5BTreeVersion2::readChunkRecord(const H5Object& record,
+                                               size_t rank,
+                                               uint64_t chunkSize) const {
+    // the scaled offsets of the chunk follow the filter mask
+    if (_btreeType == 11)
+        return readFilteredChunkRecord(record, _recordSize - 8 - 4 - rank * 8);
+    return H5ChunkRecord{record.read_u64(0), chunkSize, 0};
 }
 
 void H5BTreeVersion2::init() {
@@ -179,54 +329,42 @@ size_t H5BTreeVersion2::getRecordAddressWithinInternalNode(
 size_t H5BTreeVersion2::getRecordAddressWithinInternalNodeFromLinkHash(
         uint32_t linkHash,
         const Node& node) const {
-    for (size_t record = 0; record < node.numberOfRecords; ++record) {
-        size_t recordOffset = 6 + record * _recordSize;
-        uint32_t recordHash = node.read_u32(recordOffset);
-        if (linkHash < recordHash) {
-            if (node.depth == 0)
-                throw std::out_of_range("hash not found");
-            return getRecordAddressWithinInternalNodeFromLinkHash(
-                    linkHash, getChildNode(node, record));
-        } else if (linkHash == recordHash) {
-            return node.offset() + recordOffset;
-        } else {
-            continue;
-        }
+    size_t record = lowerBound(node.numberOfRecords, [&](size_t i) {
+        return node.read_u32(6 + i * _recordSize) < linkHash;
+    });
+    size_t recordOffset = 6 + record * _recordSize;
+    if (record < node.numberOfRecords &&
+        node.read_u32(recordOffset) == linkHash)
+    {
+        return node.offset() + recordOffset;
     }
     if (node.depth == 0)
-        throw std::out_of_range("hash not found");
+        return H5_INVALID_ADDRESS;
     return getRecordAddressWithinInternalNodeFromLinkHash(
-            linkHash, getChildNode(node, node.numberOfRecords));
+            linkHash, getChildNode(node, record));
 }
 
 H5BTreeVersion2::Node H5BTreeVersion2::getChildNode(
         const H5BTreeVersion2::Node& parentNode,
         size_t childNodeNumber) const {
-    Node childNode(H5Object(fileAddress(),
-                            getChildNodeAddress(parentNode, childNodeNumber)));
-    childNode.numberOfRecords =
-            getNumberOfRecordsForChildNode(parentNode, childNodeNumber);
-    childNode.depth = parentNode.depth - 1;
-    return childNode;
+    return makeNode(getChildNodeAddress(parentNode, childNodeNumber),
+                    getNumberOfRecordsForChildNode(parentNode, childNodeNumber),
+                    parentNode.depth - 1);
 }
 
 size_t H5BTreeVersion2::getChildNodeAddress(const Node& parentNode,
                                             size_t childNodeNumber) const {
     assert(parentNode.depth > 0);
-    size_t address =
-            6 + _recordSize * parentNode.numberOfRecords +
-            childNodeNumber * getSizeOfChildPointerMultiplet(parentNode.depth);
-    return parentNode.read_u64(address);
+    return parentNode.read_u64(parentNode.childPointersOffset +
+                               childNodeNumber * parentNode.childPointerSize);
 }
 
 size_t H5BTreeVersion2::getNumberOfRecordsForChildNode(
         const Node& parentNode,
         size_t childNodeNumber) const {
     assert(parentNode.depth > 0);
-    size_t address =
-            6 + _recordSize * parentNode.numberOfRecords +
-            childNodeNumber * getSizeOfChildPointerMultiplet(parentNode.depth) +
-            8;
+    size_t address = parentNode.childPointersOffset +
+                     childNodeNumber * parentNode.childPointerSize + 8;
     return parentNode.readIntegerAt(address,
                                     _sizeOfNumberOfRecordsForChildNode);
 }
@@ -238,10 +376,9 @@ size_t H5BTreeVersion2::getTotalNumberOfRecordsForChildNode(
     if (parentNode.depth == 1) {
         return getNumberOfRecordsForChildNode(parentNode, childNodeNumber);
     } else {
-        size_t address = 6 + _recordSize * parentNode.numberOfRecords +
-                         childNodeNumber * getSizeOfChildPointerMultiplet(
-                                                   parentNode.depth) +
-                         8 + _sizeOfNumberOfRecordsForChildNode;
+        size_t address = parentNode.childPointersOffset +
+                         childNodeNumber * parentNode.childPointerSize + 8 +
+                         _sizeOfNumberOfRecordsForChildNode;
         return parentNode.readIntegerAt(
                 address, _sizeOfTotalNumberOfRecordsForChild[parentNode.depth]);
     }
@@ -2,7 +2,9 @@
 
 #ifndef BTREEVERSION2_H
 #define BTREEVERSION2_H
+#include <dectris/neggia/data/H5ChunkRecord.h>
 #include <dectris/neggia/data/H5Object.h>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -12,14 +14,50 @@ public:
     H5BTreeVersion2(const char* fileAddress, size_t offset);
     H5BTreeVersion2(const H5Object& obj);
     size_t getNumberOfRecords() const;
+    // Throws std::out_of_range if there is no link with the name
     size_t getLinkAddressByName(const std::string& linkName) const;
-    size_t getChunkAddressByOffset(const std::vector<size_t> chunkOffset) const;
+    // Like getLinkAddressByName, returns false if there is no link with the
+    // name
+    bool tryGetLinkAddressByName(const std::string& linkName,
+                                 size_t& recordAddress) const;
+    // Calls recordCallback with the file offset of every record, in the order
+    // of the keys
+    void forEachRecord(const std::function<void(size_t)>& recordCallback) const;
+    // Records of filtered chunks (type 11) store the size and filter mask of
+    // each chunk, unfiltered chunks (type 10) have chunkSize bytes.
+    H5ChunkRecord getChunkRecordByOffset(const std::vector<size_t> chunkOffset,
+                                         uint64_t chunkSize) const;
+    // Calls chunkCallback with the scaled offset and the record of every
+    // chunk (type 10 or 11) from firstChunkOffset on, in the order of the
+    // offsets, until it returns false. The whole chunk index is read in a
+    // single walk of the tree.
+    void forEachChunkRecord(
+            const std::vector<size_t>& firstChunkOffset,
+            uint64_t chunkSize,
+            const std::function<bool(const uint64_t*, const H5ChunkRecord&)>&
+                    chunkCallback) const;
+    // Chunks of frames [firstFrame, firstFrame + numberOfFrames) of a dataset
+    // with rank dimensions which is chunked frame by frame, found in a single
+    // walk of the tree. Chunks which are not stored have the address
+    // H5ChunkRecord::UNDEFINED_ADDRESS.
+    std::vector<H5ChunkRecord> getChunkRecordsOfFrames(
+            size_t rank,
+            size_t firstFrame,
+            size_t numberOfFrames,
+            uint64_t chunkSize) const;
 
 private:
+    // The layout of the child pointers is decoded once when a node is
+    // created
     struct Node : public H5Object {
         Node(const H5Object&);
         size_t numberOfRecords;
         size_t depth;
+        // offset of the child pointers in the node and size of one child
+        // pointer (address, number of records and, below depth 1, total
+        // number of records of the child)
+        size_t childPointersOffset;
+        size_t childPointerSize;
     };
 
     void init();
@@ -28,12 +66,31 @@ private:
     size_t getSizeOfChildPointerMultiplet(size_t depth) const;
     size_t getRecordAddressWithinInternalNode(size_t record,
                                               const Node& node) const;
+    // H5_INVALID_ADDRESS if the hash is not found
     size_t getRecordAddressWithinInternalNodeFromLinkHash(
             uint32_t linkHash,
             const Node& node) const;
-    size_t getChunkAddressByOffsetWithinInternalNode(
+    void forEachRecordWithinInternalNode(
+            const std::function<void(size_t)>& recordCallback,
+            const Node& node) const;
+    size_t getChunkRecordAddressByOffsetWithinInternalNode(
             const std::vector<size_t> chunkOffset,
             const Node& node) const;
+    // index of the first record of the node whose chunk offset is not
+    // smaller than chunkOffset, found by binary search
+    size_t lowerBoundOfChunkOffset(const std::vector<size_t>& chunkOffset,
+                                   const Node& node) const;
+    // false if chunkCallback has stopped the walk
+    bool forEachChunkRecordWithinInternalNode(
+            const std::vector<size_t>& firstChunkOffset,
+            uint64_t chunkSize,
+            const std::function<bool(const uint64_t*, const H5ChunkRecord&)>&
+                    chunkCallback,
+            const Node& node) const;
+    H5ChunkRecord readChunkRecord(const H5Object& record,
+                                  size_t rank,
+                                  uint64_t chunkSize) const;
+    Node makeNode(size_t address, size_t numberOfRecords, size_t depth) const;
     Node getChildNode(const Node& parentNode, size_t childNodeNumber) const;
     size_t getChildNodeAddress(const Node& parentNode,
                                size_t childNodeNumber) const;
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef H5_CHUNK_RECORD_H
+#define H5_CHUNK_RECORD_H
+#include <cstdint>
+#include "H5Object.h"
+#include "constants.h"
+
+// Location of a chunk in the file, as stored in a chunk index
+struct H5ChunkRecord {
+    constexpr static uint64_t UNDEFINED_ADDRESS = H5_INVALID_ADDRESS;
+    // UNDEFINED_ADDRESS if the chunk is not stored
+    uint64_t address;
+    // size of the chunk in the file, which is smaller than the data of the
+    // chunk if the chunk is compressed
+    uint64_t size;
+    // bit i is set if filter i of the pipeline was not applied to the chunk
+    uint32_t filterMask;
+};
+
+// Chunk indices of filtered chunks store the address, the size in
+// chunkSizeLength bytes and the filter mask of each chunk.
+inline H5ChunkRecord readFilteredChunkRecord(const H5Object& entry,
+                                             size_t chunkSizeLength) {
+    return H5ChunkRecord{entry.read_u64(0),
+                         entry.readIntegerAt(8, chunkSizeLength),
+                         entry.read_u32(8 + chunkSizeLength)};
+}
+
+#endif  // H5_CHUNK_RECORD_H
@@ -9,6 +9,7 @@
 #include "H5ExtensibleArray.h"
 #include "H5FixedArray.h"
 #include "JenkinsLookup3Checksum.h"
+#include "constants.h"
 
 #define DEBUG_OFFSET 0
 
@@ -126,38 +127,142 @@ void H5DataLayoutMsg::_init() {
 
 H5DataLayoutMsg::ConstDataPointer H5DataLayoutMsg::getRawData(
         size_t elementSize,
-        const std::vector<size_t>& chunkOffset) const {
-    const char* rawData = nullptr;
-    size_t rawDataSize = 0;
+        const std::vector<size_t>& chunkOffset,
+        const std::vector<size_t>& maxDim) const {
     if (_isChunked) {
-        switch (version()) {
-            case 3:
-                return chunkedDataV3(chunkOffset);
-            case 4:
-                return chunkedDataV4(elementSize, chunkOffset);
-            default:
-                throw std::runtime_error("Data Layout Message version " +
-                                         std::to_string((int)version()) +
-                                         " not supported.");
-        }
+        ChunkRecord chunk = getChunkRecord(elementSize, chunkOffset, maxDim);
+        return ConstDataPointer{fileAddress() + chunk.address, chunk.size};
     }
     return ConstDataPointer{dataAddress(), dataSize()};
 }
 
+H5DataLayoutMsg::ChunkRecord H5DataLayoutMsg::getChunkRecord(
+        size_t elementSize,
+        const std::vector<size_t>& chunkOffset,
+        const std::vector<size_t>& maxDim) const {
+    if (!_isChunked)
+        throw std::runtime_error("data is not chunked");
+    ChunkRecord chunk;
+    switch (version()) {
+        case 3:
+            chunk = chunkRecordV3(chunkOffset);
+            break;
+        case 4:
+            chunk = chunkRecordV4(elementSize, scaledChunkOffset(chunkOffset),
+                                  maxDim);
+            break;
+        default:
+            throw std::runtime_error("Data Layout Message version " +
+                                     std::to_string((int)version()) +
+                                     " not supported.");
+    }
+    if (chunk.address == ChunkRecord::UNDEFINED_ADDRESS)
+        throw std::out_of_range("chunk not found");
+    return chunk;
+}
+
+std::vector<H5DataLayoutMsg::ChunkRecord>
+H5DataLayoutMsg::getChunkRecordsOfFrames(
+        size_t elementSize,
+        size_t firstFrame,
+        size_t numberOfFrames,
+        const std::vector<size_t>& maxDim) const {
+    if (!_isChunked)
+        throw std::runtime_error("data is not chunked");
+    switch (version()) {
+        case 3:
+            return chunkRecordsOfFramesV3(firstFrame, numberOfFrames);
+        case 4:
+            return chunkRecordsOfFramesV4(elementSize, firstFrame,
+                                          numberOfFrames, maxDim);
+        default:
+            throw std::runtime_error("Data Layout Message version " +
+                                     std::to_string((int)version()) +
+                                     " not supported.");
+    }
+}
+
+std::vector<H5DataLayoutMsg::ChunkRecord> H5DataLayoutMsg::getChunkRecords(
+        size_t elementSize,
+        const std::vector<std::vector<size_t>>& chunkOffsets,
+        const std::vector<size_t>& maxDim) const {
+    if (!_isChunked)
+        throw std::runtime_error("data is not chunked");
+    if (version() == 3)
+        return chunkRecordsV3(chunkOffsets);
+    if (chunkIndexingType() == 5)
+        return chunkRecordsFromBTreeV2Storage(elementSize, chunkOffsets);
+    std::vector<ChunkRecord> records;
+    records.reserve(chunkOffsets.size());
+    for (const auto& chunkOffset : chunkOffsets) {
+        std::vector<size_t> scaledOffset = scaledChunkOffset(chunkOffset);
+        ChunkRecord record{ChunkRecord::UNDEFINED_ADDRESS, 0, 0};
+        try {
+            record = chunkRecordV4(elementSize, scaledOffset, maxDim);
+        } catch (const std::out_of_range&) {
+            // not stored
+        }
+        records.push_back(record);
+    }
+    return records;
+}
+
 namespace {
+// chunks are sorted by their offset in the first dimension, then the second
+// and so on
 template <class T1, class T2>
-bool chunkCompareGreaterEqual(const T1* key0, const T2* key1, size_t len) {
-    for (ssize_t idx = ((ssize_t)len) - 1; idx >= 0; --idx) {
+int chunkCompare(const T1* key0, const T2* key1, size_t len) {
+    for (size_t idx = 0; idx < len; ++idx) {
         if (key0[idx] < key1[idx])
-            return false;
+            return -1;
         if (key0[idx] > key1[idx])
-            return true;
+            return 1;
     }
-    return true;
+    return 0;
+}
+
+// keys of the v1 B-tree: chunk size, filter mask and offset of the chunk,
+// with one dimension more than the dataset
+const uint64_t* keyOffset(const H5Object& key) {
+    return (const uint64_t*)key.address(8);
+}
+
+typedef std::function<bool(const uint64_t*, const H5ChunkRecord&)>
+        ChunkCallback;
+
+// Records of the chunks at the sorted chunk offsets, found in a single walk
+// over the chunk index which starts at the first offset and calls its
+// callback with the offset and record of every stored chunk in order.
+std::vector<H5ChunkRecord> findChunkRecords(
+        const std::vector<std::vector<size_t>>& chunkOffsets,
+        const std::function<void(const std::vector<size_t>&,
+                                 const ChunkCallback&)>& walk) {
+    std::vector<H5ChunkRecord> records(
+            chunkOffsets.size(),
+            H5ChunkRecord{H5ChunkRecord::UNDEFINED_ADDRESS, 0, 0});
+    if (chunkOffsets.empty())
+        return records;
+    const size_t rank = chunkOffsets[0].size();
+    size_t next = 0;
+    walk(chunkOffsets[0], [&](const uint64_t* chunkOffset,
+                              const H5ChunkRecord& record) {
+        // chunks before chunkOffset are not stored
+        while (next < chunkOffsets.size() &&
+               chunkCompare(chunkOffsets[next].data(), chunkOffset, rank) < 0)
+        {
+            ++next;
+        }
+        if (next == chunkOffsets.size())
+            return false;
+        if (chunkCompare(chunkOffsets[next].data(), chunkOffset, rank) == 0)
+            records[next++] = record;
+        return true;
+    });
+    return records;
 }
 }  // namespace
 
-H5DataLayoutMsg::ConstDataPointer H5DataLayoutMsg::chunkedDataV3(
+H5DataLayoutMsg::ChunkRecord H5DataLayoutMsg::chunkRecordV3(
         const std::vector<size_t>& chunkOffset) const {
     // internally hdf5 stores chunk size with one dimension more than the
     // dimensions of the dataset
@@ -165,66 +270,316 @@ H5DataLayoutMsg::ConstDataPointer H5DataLayoutMsg::chunkedDataV3(
     std::vector<size_t> chunkOffsetFullSize(chunkOffset);
     while (chunkOffsetFullSize.size() < _chunkShape.size() + 1)
         chunkOffsetFullSize.push_back(0);
-    H5Object dataChunk(extractDataChunk(chunkOffsetFullSize));
-    const char* rawData =
-            dataChunk.fileAddress() +
-            dataChunk.read_u64(8 + chunkOffsetFullSize.size() * 8);
-    size_t rawDataSize = dataChunk.read_u32(0);
-    return ConstDataPointer{rawData, rawDataSize};
+    const size_t keySize = 8 + chunkOffsetFullSize.size() * 8;
+    H5Object key;
+    if (!extractDataChunk(chunkOffsetFullSize, key))
+        return ChunkRecord{ChunkRecord::UNDEFINED_ADDRESS, 0, 0};
+    return ChunkRecord{key.read_u64(keySize), key.read_u32(0), key.read_u32(4)};
 }
 
-H5DataLayoutMsg::ConstDataPointer H5DataLayoutMsg::chunkedDataV4(
+H5DataLayoutMsg::ChunkRecord H5DataLayoutMsg::chunkRecordV4(
         size_t elementSize,
+        const std::vector<size_t>& scaledOffset,
+        const std::vector<size_t>& maxDim) const {
+    // the size of unfiltered chunks is not stored in the chunk index
+    uint64_t chunkSize = chunkDataSize(elementSize);
+    switch (chunkIndexingType()) {
+        case 1:
+            return chunkFromSingleChunkStorage(scaledOffset, chunkSize);
+        case 2:
+            return chunkFromImplicitStorage(
+                    chunkArrayIndex(scaledOffset, maxDim), chunkSize);
+        case 3:
+            return chunkFromFixedArrayStorage(
+                    chunkArrayIndex(scaledOffset, maxDim), chunkSize);
+        case 4:
+            return chunkFromExtensibleArrayStorage(
+                    chunkArrayIndex(scaledOffset, maxDim), chunkSize);
+        case 5:
+            return chunkFromBTreeV2Storage(scaledOffset, chunkSize);
+        default:
+            throw std::runtime_error("chunk indexing type " +
+                                     std::to_string((int)chunkIndexingType()) +
+                                     " not supported.");
+    }
+}
+
+size_t H5DataLayoutMsg::chunkDataSize(size_t elementSize) const {
+    size_t size = elementSize;
+    for (size_t d : _chunkShape)
+        size *= d;
+    return size;
+}
+
+std::vector<size_t> H5DataLayoutMsg::scaledChunkOffset(
         const std::vector<size_t>& chunkOffset) const {
-    assert(_chunkShape.size() == chunkOffset.size());
+    if (chunkOffset.size() != _chunkShape.size()) {
+        throw std::out_of_range("chunk offset of rank " +
+                                std::to_string(chunkOffset.size()) +
+                                " in a dataset of rank " +
+                                std::to_string(_chunkShape.size()));
+    }
+    std::vector<size_t> scaledOffset;
+    for (size_t i = 0; i < chunkOffset.size(); ++i) {
+        if (chunkOffset[i] % _chunkShape[i] != 0)
+            throw std::out_of_range("offset is not the start of a chunk");
+        scaledOffset.push_back(chunkOffset[i] / _chunkShape[i]);
+    }
+    return scaledOffset;
+}
+
+size_t H5DataLayoutMsg::chunkArrayIndex(
+        const std::vector<size_t>& scaledOffset,
+        const std::vector<size_t>& maxDim) const {
+    assert(maxDim.size() == _chunkShape.size());
+    // the unlimited dimension of extensible arrays varies slowest, see
+    // H5D__earray_idx_get_addr() in the hdf5 library
+    std::vector<size_t> order;
+    for (size_t i = 0; i < maxDim.size(); ++i) {
+        if (maxDim[i] == H5_UNLIMITED)
+            order.push_back(i);
+    }
+    for (size_t i = 0; i < maxDim.size(); ++i) {
+        if (maxDim[i] != H5_UNLIMITED)
+            order.push_back(i);
+    }
+    size_t index = 0;
+    for (size_t i : order) {
+        size_t maxChunks =
+                maxDim[i] == H5_UNLIMITED
+                        ? 0
+                        : (maxDim[i] + _chunkShape[i] - 1) / _chunkShape[i];
+        // the chunk would wrap into the next row of chunks
+        if (maxDim[i] != H5_UNLIMITED && scaledOffset[i] >= maxChunks)
+            throw std::out_of_range("chunk not found");
+        index = index * maxChunks + scaledOffset[i];
+    }
+    return index;
+}
+
+std::vector<H5DataLayoutMsg::ChunkRecord>
+H5DataLayoutMsg::chunkRecordsOfFramesV3(size_t firstFrame,
+                                        size_t numberOfFrames) const {
+    std::vector<size_t> firstOffset(_chunkShape.size() + 1, 0);
+    firstOffset[0] = firstFrame;
+    std::vector<ChunkRecord> records(
+            numberOfFrames, ChunkRecord{ChunkRecord::UNDEFINED_ADDRESS, 0, 0});
+    if (numberOfFrames == 0)
+        return records;
+    size_t endFrame = firstFrame + numberOfFrames;
+    forEachChunkRecordV3(
+            firstOffset,
+            [&](const uint64_t* chunkOffset, const ChunkRecord& record) {
+                if (chunkOffset[0] >= endFrame)
+                    return false;
+                records[chunkOffset[0] - firstFrame] = record;
+                return true;
+            });
+    return records;
+}
+
+std::vector<H5DataLayoutMsg::ChunkRecord> H5DataLayoutMsg::chunkRecordsV3(
+        const std::vector<std::vector<size_t>>& chunkOffsets) const {
+    // the keys have one dimension more than the dataset
+    std::vector<std::vector<size_t>> keyOffsets(chunkOffsets);
+    for (auto& offset : keyOffsets)
+        offset.resize(_chunkShape.size() + 1, 0);
+    return findChunkRecords(keyOffsets, [this](const std::vector<size_t>& first,
+                                               const ChunkCallback& callback) {
+        forEachChunkRecordV3(first, callback);
+    });
+}
+
+std::vector<H5DataLayoutMsg::ChunkRecord>
+H5DataLayoutMsg::chunkRecordsFromBTreeV2Storage(
+        size_t elementSize,
+        const std::vector<std::vector<size_t>>& chunkOffsets) const {
+    std::vector<std::vector<size_t>> scaledOffsets;
+    scaledOffsets.reserve(chunkOffsets.size());
+    for (const auto& chunkOffset : chunkOffsets)
+        scaledOffsets.push_back(scaledChunkOffset(chunkOffset));
+    size_t headerAddress = read_u64(12 + dimensionSize() * chunkDims());
+    H5BTreeVersion2 btree(fileAddress(), headerAddress);
+    uint64_t chunkSize = chunkDataSize(elementSize);
+    return findChunkRecords(
+            scaledOffsets, [&](const std::vector<size_t>& first,
+                               const ChunkCallback& callback) {
+                btree.forEachChunkRecord(first, chunkSize, callback);
+            });
+}
+
+void H5DataLayoutMsg::forEachChunkRecordV3(
+        const std::vector<size_t>& firstOffset,
+        const std::function<bool(const uint64_t*, const ChunkRecord&)>&
+                chunkCallback) const {
+    const size_t keySize = 8 + firstOffset.size() * 8;
+    const size_t childSize = 8;
+    H5BLinkNode bTree = findLeafNode(firstOffset);
+    int first = lowerBound(bTree, firstOffset);
+    // the leaf nodes are linked in the order of their keys
+    while (true) {
+        for (int i = first; i < bTree.entriesUsed(); ++i) {
+            H5Object key(bTree + 24 + i * (keySize + childSize));
+            if (!chunkCallback(keyOffset(key),
+                               ChunkRecord{key.read_u64(keySize),
+                                           key.read_u32(0), key.read_u32(4)}))
+            {
+                return;
+            }
+        }
+        uint64_t rightSibling = bTree.read_u64(16);
+        if (rightSibling == H5_INVALID_ADDRESS)
+            return;
+        bTree = H5BLinkNode(fileAddress(), rightSibling);
+        first = 0;
+    }
+}
+
+std::vector<H5DataLayoutMsg::ChunkRecord>
+H5DataLayoutMsg::chunkRecordsOfFramesV4(
+        size_t elementSize,
+        size_t firstFrame,
+        size_t numberOfFrames,
+        const std::vector<size_t>& maxDim) const {
     assert(_chunkShape[0] == 1);
-    const char* rawData;
-    size_t rawDataSize = _chunkShape[1] * _chunkShape[2] * elementSize;
+    size_t rawDataSize = chunkDataSize(elementSize);
+    std::vector<size_t> scaledOffset(_chunkShape.size(), 0);
+    std::vector<ChunkRecord> records;
     switch (chunkIndexingType()) {
         case 3: {
-            rawData = addressFromFixedArrayStorage(chunkOffset);
+            size_t headerAddress = read_u64(7 + dimensionSize() * chunkDims());
+            H5FixedArrayHeader header(fileAddress(), headerAddress);
+            for (size_t i = 0; i < numberOfFrames; ++i) {
+                scaledOffset[0] = firstFrame + i;
+                ChunkRecord record{ChunkRecord::UNDEFINED_ADDRESS, 0, 0};
+                try {
+                    size_t index = chunkArrayIndex(scaledOffset, maxDim);
+                    if (index < header.numElements())
+                        record = header.chunkRecord(index, rawDataSize);
+                } catch (const std::out_of_range&) {
+                    // beyond the maximum dimensions
+                }
+                records.push_back(record);
+            }
             break;
         }
         case 4: {
-            rawData = addressFromExtensibleArrayStorage(chunkOffset);
+            size_t headerAddress =
+                    read_u64(11 + dimensionSize() * chunkDims());
+            H5ExtensibleArrayHeader header(fileAddress(), headerAddress);
+            // elements outside of the index block cannot be read yet
+            for (size_t i = 0; i < numberOfFrames; ++i) {
+                scaledOffset[0] = firstFrame + i;
+                size_t index;
+                try {
+                    index = chunkArrayIndex(scaledOffset, maxDim);
+                } catch (const std::out_of_range&) {
+                    break;
+                }
+                if (index >= header.numElements() ||
+                    index >= header.numElementsInIndexBlock())
+                {
+                    break;
+                }
+                records.push_back(header.chunkRecord(index, rawDataSize));
+            }
             break;
         }
         case 5: {
-            rawData = addressFromBTreeV2Storage(chunkOffset);
+            size_t headerAddress =
+                    read_u64(12 + dimensionSize() * chunkDims());
+            H5BTreeVersion2 btree(fileAddress(), headerAddress);
+            records = btree.getChunkRecordsOfFrames(
+                    _chunkShape.size(), firstFrame, numberOfFrames,
+                    rawDataSize);
             break;
         }
         default:
-            throw std::runtime_error("chunk indexing type " +
-                                     std::to_string((int)chunkIndexingType()) +
-                                     " not supported.");
+            for (size_t i = 0; i < numberOfFrames; ++i) {
+                scaledOffset[0] = firstFrame + i;
+                records.push_back(
+                        chunkRecordV4(elementSize, scaledOffset, maxDim));
+            }
     }
-    return ConstDataPointer{rawData, rawDataSize};
+    return records;
 }
 
-const char* H5DataLayoutMsg::addressFromExtensibleArrayStorage(
-        const std::vector<size_t>& chunkOffset) const {
+H5DataLayoutMsg::ChunkRecord H5DataLayoutMsg::chunkFromSingleChunkStorage(
+        const std::vector<size_t>& scaledOffset,
+        uint64_t chunkSize) const {
+    for (size_t offset : scaledOffset) {
+        if (offset != 0)
+            throw std::out_of_range("chunk not found");
+    }
+    size_t infoOffset = 6 + dimensionSize() * chunkDims();
+    // flag: the chunk is filtered
+    if (read_u8(2) & 0x2) {
+        return ChunkRecord{read_u64(infoOffset + 12),
+                           read_u64(infoOffset),
+                           read_u32(infoOffset + 8)};
+    }
+    return ChunkRecord{read_u64(infoOffset), chunkSize, 0};
+}
+
+H5DataLayoutMsg::ChunkRecord H5DataLayoutMsg::chunkFromImplicitStorage(
+        size_t index,
+        uint64_t chunkSize) const {
+    // the chunks are stored one after the other
+    uint64_t address = read_u64(6 + dimensionSize() * chunkDims());
+    if (address == H5_INVALID_ADDRESS)
+        return ChunkRecord{ChunkRecord::UNDEFINED_ADDRESS, 0, 0};
+    return ChunkRecord{address + index * chunkSize, chunkSize, 0};
+}
+
+H5DataLayoutMsg::ChunkRecord H5DataLayoutMsg::chunkFromExtensibleArrayStorage(
+        size_t index,
+        uint64_t chunkSize) const {
     size_t headerAddress = read_u64(11 + dimensionSize() * chunkDims());
     H5ExtensibleArrayHeader header(fileAddress(), headerAddress);
-    assert(chunkOffset[0] < header.numElements());
-    return fileAddress() + header.element(chunkOffset[0]);
+    if (index >= header.numElements())
+        throw std::out_of_range("chunk not found");
+    return header.chunkRecord(index, chunkSize);
 }
 
-const char* H5DataLayoutMsg::addressFromFixedArrayStorage(
-        const std::vector<size_t>& chunkOffset) const {
+H5DataLayoutMsg::ChunkRecord H5DataLayoutMsg::chunkFromFixedArrayStorage(
+        size_t index,
+        uint64_t chunkSize) const {
     size_t headerAddress = read_u64(7 + dimensionSize() * chunkDims());
     H5FixedArrayHeader header(fileAddress(), headerAddress);
-    assert(chunkOffset[0] < header.numElements());
-    return fileAddress() + header.element(chunkOffset[0]);
+    if (index >= header.numElements())
+        throw std::out_of_range("chunk not found");
+    return header.chunkRecord(index, chunkSize);
 }
 
-const char* H5DataLayoutMsg::addressFromBTreeV2Storage(
-        const std::vector<size_t>& chunkOffset) const {
+H5DataLayoutMsg::ChunkRecord H5DataLayoutMsg::chunkFromBTreeV2Storage(
+        const std::vector<size_t>& scaledOffset,
+        uint64_t chunkSize) const {
     size_t headerAddress = read_u64(12 + dimensionSize() * chunkDims());
     H5BTreeVersion2 btree(fileAddress(), headerAddress);
-    return fileAddress() + btree.getChunkAddressByOffset(chunkOffset);
+    return btree.getChunkRecordByOffset(scaledOffset, chunkSize);
 }
 
-H5Object H5DataLayoutMsg::extractDataChunk(
+int H5DataLayoutMsg::lowerBound(const H5BLinkNode& node,
+                                const std::vector<size_t>& offset) const {
+    const size_t keySize = 8 + offset.size() * 8;
+    const size_t childSize = 8;
+    // the keys of the children are sorted
+    int first = 0;
+    int count = node.entriesUsed();
+    while (count > 0) {
+        int step = count / 2;
+        H5Object key(node + 24 + (first + step) * (keySize + childSize));
+        if (chunkCompare(keyOffset(key), offset.data(), offset.size()) < 0) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first;
+}
+
+H5BLinkNode H5DataLayoutMsg::findLeafNode(
         const std::vector<size_t>& offset) const {
     const size_t keySize = 8 + offset.size() * 8;
     const size_t childSize = 8;
@@ -232,31 +587,33 @@ H5Object H5DataLayoutMsg::extractDataChunk(
     H5BLinkNode bTree(fileAddress(), linkOffset);
 
     while (bTree.nodeLevel() > 0) {
-        bool found = false;
-        for (int i = bTree.entriesUsed() - 1; i >= 0; --i) {
-            H5Object key(bTree + 24 + i * (keySize + childSize));
-            if (chunkCompareGreaterEqual(offset.data(),
-                                         (const uint64_t*)key.address(8),
-                                         offset.size()))
-            {
-                bTree = H5BLinkNode(key.fileAddress(), key.read_u64(keySize));
-                found = true;
-                break;
-            }
+        // the last child whose first key is not greater than offset; offsets
+        // before the first key continue in the first child, where the leaf
+        // node lookup does not find them
+        int child = lowerBound(bTree, offset);
+        if (child == bTree.entriesUsed()) {
+            --child;
+        } else if (child > 0) {
+            H5Object key(bTree + 24 + child * (keySize + childSize));
+            if (chunkCompare(keyOffset(key), offset.data(), offset.size()) > 0)
+                --child;
         }
-        if (!found)
-            throw std::runtime_error("Not found");
+        H5Object key(bTree + 24 + child * (keySize + childSize));
+        bTree = H5BLinkNode(key.fileAddress(), key.read_u64(keySize));
     }
+    return bTree;
+}
 
-    for (int i = 0; i < bTree.entriesUsed(); ++i) {
-        H5Object key(bTree + 24 + i * (keySize + childSize));
-        if (memcmp(key.address(8), offset.data(),
-                   offset.size() * sizeof(uint64_t)) == 0)
-        {
-            return key;
-        }
-    }
-    throw std::runtime_error("Not found");
+bool H5DataLayoutMsg::extractDataChunk(const std::vector<size_t>& offset,
+                                       H5Object& key) const {
+    const size_t keySize = 8 + offset.size() * 8;
+    const size_t childSize = 8;
+    H5BLinkNode bTree = findLeafNode(offset);
+    int i = lowerBound(bTree, offset);
+    if (i == bTree.entriesUsed())
+        return false;
+    key = bTree + 24 + i * (keySize + childSize);
+    return chunkCompare(keyOffset(key), offset.data(), offset.size()) == 0;
 }
 
 bool H5DataLayoutMsg::isChunked() const {
@@ -2,7 +2,9 @@
 
 #ifndef H5DATALAYOUTMSG_H
 #define H5DATALAYOUTMSG_H
+#include <functional>
 #include "H5BLinkNode.h"
+#include "H5ChunkRecord.h"
 #include "H5Object.h"
 #include "H5ObjectHeader.h"
 
@@ -14,14 +16,44 @@ public:
         const char* data;
         size_t size;
     };
+    typedef H5ChunkRecord ChunkRecord;
     H5DataLayoutMsg() = default;
     H5DataLayoutMsg(const char* fileAddress, size_t offset);
     H5DataLayoutMsg(const H5Object&);
     uint8_t version() const;
     uint8_t layoutClass() const;
 
+    // chunkOffset is the offset of the first element of the chunk in the
+    // dataset. maxDim are the maximum dimensions of the dataset (H5_UNLIMITED
+    // for unlimited dimensions), which determine the position of a chunk in
+    // fixed and extensible arrays. Throws std::out_of_range if the chunk is
+    // not stored.
     ConstDataPointer getRawData(size_t elementSize,
-                                const std::vector<size_t>& chunkOffset) const;
+                                const std::vector<size_t>& chunkOffset,
+                                const std::vector<size_t>& maxDim) const;
+    // Like getRawData, but returns the record of the chunk in the chunk
+    // index, with the filter mask of the chunk
+    ChunkRecord getChunkRecord(size_t elementSize,
+                               const std::vector<size_t>& chunkOffset,
+                               const std::vector<size_t>& maxDim) const;
+    // Chunks of frames [firstFrame, firstFrame + numberOfFrames) of a dataset
+    // which is chunked frame by frame, found in a single walk of the chunk
+    // index. Fewer records are returned if the rest of the index is stored
+    // in a way which is not supported.
+    std::vector<ChunkRecord> getChunkRecordsOfFrames(
+            size_t elementSize,
+            size_t firstFrame,
+            size_t numberOfFrames,
+            const std::vector<size_t>& maxDim) const;
+    // Records of the chunks at chunkOffsets, which must be sorted like the
+    // chunks are stored (by their offset in the first dimension, then the
+    // second and so on). Chunks indexed by a version 1 or version 2 B-tree
+    // are found in a single walk of the tree. Chunks which are not stored
+    // have the address ChunkRecord::UNDEFINED_ADDRESS.
+    std::vector<ChunkRecord> getChunkRecords(
+            size_t elementSize,
+            const std::vector<std::vector<size_t>>& chunkOffsets,
+            const std::vector<size_t>& maxDim) const;
 
     bool isChunked() const;
     std::vector<size_t> chunkShape() const;
@@ -39,19 +71,64 @@ private:
     const char* dataAddress() const;
 
     /// for chunked data (layout class 2)
-    ConstDataPointer chunkedDataV3(
+    ChunkRecord chunkRecordV3(const std::vector<size_t>& chunkOffset) const;
+    ChunkRecord chunkRecordV4(size_t elementSize,
+                              const std::vector<size_t>& scaledOffset,
+                              const std::vector<size_t>& maxDim) const;
+    size_t chunkDataSize(size_t elementSize) const;
+    // chunk offset in units of the chunk shape
+    std::vector<size_t> scaledChunkOffset(
             const std::vector<size_t>& chunkOffset) const;
-    ConstDataPointer chunkedDataV4(
+    // position of a chunk in fixed arrays, extensible arrays and implicit
+    // chunk indices. Throws std::out_of_range if the chunk is outside of the
+    // maximum dimensions.
+    size_t chunkArrayIndex(const std::vector<size_t>& scaledOffset,
+                           const std::vector<size_t>& maxDim) const;
+    ChunkRecord chunkFromSingleChunkStorage(
+            const std::vector<size_t>& scaledOffset,
+            uint64_t chunkSize) const;
+    ChunkRecord chunkFromImplicitStorage(size_t index,
+                                         uint64_t chunkSize) const;
+    ChunkRecord chunkFromFixedArrayStorage(size_t index,
+                                           uint64_t chunkSize) const;
+    ChunkRecord chunkFromExtensibleArrayStorage(size_t index,
+                                                uint64_t chunkSize) const;
+    ChunkRecord chunkFromBTreeV2Storage(const std::vector<size_t>& scaledOffset,
+                                        uint64_t chunkSize) const;
+
+    std::vector<ChunkRecord> chunkRecordsOfFramesV3(
+            size_t firstFrame,
+            size_t numberOfFrames) const;
+    std::vector<ChunkRecord> chunkRecordsV3(
+            const std::vector<std::vector<size_t>>& chunkOffsets) const;
+    std::vector<ChunkRecord> chunkRecordsFromBTreeV2Storage(
             size_t elementSize,
-            const std::vector<size_t>& chunkOffset) const;
-    const char* addressFromFixedArrayStorage(
-            const std::vector<size_t>& chunkOffset) const;
-    const char* addressFromExtensibleArrayStorage(
-            const std::vector<size_t>& chunkOffset) const;
-    const char* addressFromBTreeV2Storage(
-            const std::vector<size_t>& chunkOffset) const;
+            const std::vector<std::vector<size_t>>& chunkOffsets) const;
+    std::vector<ChunkRecord> chunkRecordsOfFramesV4(
+            size_t elementSize,
+            size_t firstFrame,
+            size_t numberOfFrames,
+            const std::vector<size_t>& maxDim) const;
 
-    H5Object extractDataChunk(const std::vector<size_t>& chunkOffset) const;
+    // Calls chunkCallback with the offset (with one dimension more than the
+    // dataset) and the record of every chunk of the v1 B-tree from
+    // firstOffset on, in the order of the offsets, until it returns false.
+    // Walks the linked leaf nodes of the tree.
+    void forEachChunkRecordV3(
+            const std::vector<size_t>& firstOffset,
+            const std::function<bool(const uint64_t*, const ChunkRecord&)>&
+                    chunkCallback) const;
+    // index of the first key of the node of the v1 B-tree which is not
+    // smaller than chunkOffset, found by binary search
+    int lowerBound(const H5BLinkNode& node,
+                   const std::vector<size_t>& chunkOffset) const;
+    // the leaf node of the v1 B-tree which holds the chunk at chunkOffset if
+    // it is stored
+    H5BLinkNode findLeafNode(const std::vector<size_t>& chunkOffset) const;
+    // the key of the chunk at chunkOffset in its leaf node, false if the
+    // chunk is not stored
+    bool extractDataChunk(const std::vector<size_t>& chunkOffset,
+                          H5Object& key) const;
     size_t dimensionSize() const;
     uint8_t chunkIndexingType() const;
 
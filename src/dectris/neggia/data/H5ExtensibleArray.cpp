@@ -69,9 +69,10 @@ H5ExtensibleArrayIndexBlock H5ExtensibleArrayHeader::initIndexBlock() {
     // hdf5 library code:
     // https://github.com/HDFGroup/hdf5/blob/develop/src/H5EA.c#L312
 
+    // elements at and after maxIndexSet have never been set
     H5ExtensibleArrayIndexBlock indexBlock(
-            fileAddress(), indexBlockAddress, numElementsInIndexBlock,
-            numElementsInIndexBlock, elementSize);
+            fileAddress(), indexBlockAddress, maxIndexSet,
+            numElementsInIndexBlock, clientID, elementSize);
     assert(indexBlock.read_u64(6) == offset());  // consistency check
     return indexBlock;
 }
@@ -79,17 +80,42 @@ H5ExtensibleArrayIndexBlock H5ExtensibleArrayHeader::initIndexBlock() {
 size_t H5ExtensibleArrayHeader::numElements() const {
     return _indexBlock.numElements();
 }
+size_t H5ExtensibleArrayHeader::numElementsInIndexBlock() const {
+    return _indexBlock.numElementsInIndexBlock();
+}
 size_t H5ExtensibleArrayHeader::element(int i) const {
     return _indexBlock.element(i);
 }
 
+H5ChunkRecord H5ExtensibleArrayHeader::chunkRecord(int i,
+                                                   uint64_t chunkSize) const {
+    return _indexBlock.chunkRecord(i, chunkSize);
+}
+
 size_t H5ExtensibleArrayIndexBlock::numElements() const {
     return _numElements;
 }
 
+size_t H5ExtensibleArrayIndexBlock::numElementsInIndexBlock() const {
+    return _numElementsInIndexBlock;
+}
+
 size_t H5ExtensibleArrayIndexBlock::element(int i) const {
+    return read_u64(elementOffset(i));
+}
+
+H5ChunkRecord H5ExtensibleArrayIndexBlock::chunkRecord(
+        int i,
+        uint64_t chunkSize) const {
+    H5Object entry = at(elementOffset(i));
+    if (_clientID == 1)
+        return readFilteredChunkRecord(entry, _elementSize - 8 - 4);
+    return H5ChunkRecord{entry.read_u64(0), chunkSize, 0};
+}
+
+size_t H5ExtensibleArrayIndexBlock::elementOffset(int i) const {
     if (i < _numElementsInIndexBlock) {
-        return read_u64(14 + i * _elementSize);
+        return 14 + i * _elementSize;
     }
     throw std::runtime_error("elements outside of indexblock not implemented.");
 }
@@ -99,10 +125,12 @@ H5ExtensibleArrayIndexBlock::H5ExtensibleArrayIndexBlock(
         size_t offset,
         size_t numElements,
         size_t numElementsInIndexBlock,
+        uint8_t clientID,
         size_t elementSize)
       : H5Object(fileAddress, offset),
         _numElements(numElements),
         _numElementsInIndexBlock(numElementsInIndexBlock),
+        _clientID(clientID),
         _elementSize(elementSize) {
     std::string signature = std::string(address(), 4);
     assert(signature == "EAIB");
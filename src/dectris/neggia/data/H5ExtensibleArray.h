@@ -2,6 +2,7 @@
 
 #ifndef EXTENSIBLEARRAYHEADER_H
 #define EXTENSIBLEARRAYHEADER_H
+#include <dectris/neggia/data/H5ChunkRecord.h>
 #include <dectris/neggia/data/H5Object.h>
 #include <string>
 #include <vector>
@@ -12,16 +13,21 @@ public:
                                 size_t offset,
                                 size_t numElements,
                                 size_t numElementsInIndexBlock,
+                                uint8_t clientID,
                                 size_t elementSize);
 
     size_t numElements() const;
+    size_t numElementsInIndexBlock() const;
     size_t element(int i) const;
+    H5ChunkRecord chunkRecord(int i, uint64_t chunkSize) const;
 
 private:
     void init();
+    size_t elementOffset(int i) const;
 
     size_t _numElements;
     size_t _numElementsInIndexBlock;
+    uint8_t _clientID;
     size_t _elementSize;
 };
 
@@ -30,8 +36,15 @@ public:
     H5ExtensibleArrayHeader(const char* fileAddress, size_t offset);
     H5ExtensibleArrayHeader(const H5Object& obj);
 
+    // one more than the last element which was set
     size_t numElements() const;
+    // only these elements can be read yet, the others are in data blocks
+    size_t numElementsInIndexBlock() const;
     size_t element(int i) const;
+    // The chunk of element i. Arrays of filtered chunks (client ID 1) store
+    // the size and filter mask of each chunk, unfiltered chunks have
+    // chunkSize bytes.
+    H5ChunkRecord chunkRecord(int i, uint64_t chunkSize) const;
 
 private:
     H5ExtensibleArrayIndexBlock initIndexBlock();
@@ -45,8 +45,8 @@ H5FixedArrayDataBlock H5FixedArrayHeader::initDataBlock() {
     // https://github.com/HDFGroup/hdf5/blob/develop/src/H5FAdblock.c#L110
     size_t numElementsPerPage = (size_t)1 << pageBits;
 
-    H5FixedArrayDataBlock dataBlock(fileAddress(), dataBlockAddress, entrySize,
-                                    numEntries, numElementsPerPage);
+    H5FixedArrayDataBlock dataBlock(fileAddress(), dataBlockAddress, clientID,
+                                    entrySize, numEntries, numElementsPerPage);
     assert(dataBlock.read_u64(6) == offset());  // consistency check
     return dataBlock;
 }
@@ -59,12 +59,19 @@ size_t H5FixedArrayHeader::element(int i) const {
     return _dataBlock.element(i);
 }
 
+H5ChunkRecord H5FixedArrayHeader::chunkRecord(int i,
+                                              uint64_t chunkSize) const {
+    return _dataBlock.chunkRecord(i, chunkSize);
+}
+
 H5FixedArrayDataBlock::H5FixedArrayDataBlock(const char* fileAddress,
                                              size_t offset,
+                                             uint8_t clientID,
                                              size_t entrySize,
                                              size_t numEntries,
                                              size_t numElementsPerPage)
       : H5Object(fileAddress, offset),
+        _clientID(clientID),
         _entrySize(entrySize),
         _numEntries(numEntries),
         _numElementsPerPage(numElementsPerPage),
@@ -93,8 +100,20 @@ size_t H5FixedArrayDataBlock::numElements() const {
 }
 
 size_t H5FixedArrayDataBlock::element(int i) const {
+    return read_u64(entryOffset(i));
+}
+
+H5ChunkRecord H5FixedArrayDataBlock::chunkRecord(int i,
+                                                 uint64_t chunkSize) const {
+    H5Object entry = at(entryOffset(i));
+    if (_clientID == 1)
+        return readFilteredChunkRecord(entry, _entrySize - 8 - 4);
+    return H5ChunkRecord{entry.read_u64(0), chunkSize, 0};
+}
+
+size_t H5FixedArrayDataBlock::entryOffset(int i) const {
     if (_numPages == 0) {
-        return read_u64(14 + i * _entrySize);
+        return 14 + i * _entrySize;
     }
     size_t pageIndex = i / _numElementsPerPage;
     size_t pageSize = (_numElementsPerPage * _entrySize) + 4;
@@ -107,11 +126,11 @@ size_t H5FixedArrayDataBlock::element(int i) const {
         }
     }
 
-    uint32_t checksumPage = read_u32(pageStart + pageSize - 4);
-    uint32_t checkSumCalculated = JenkinsLookup3Checksum(
-            std::string(address() + pageStart, pageSize - 4));
-
-    assert(checksumPage == checkSumCalculated);
+    // only checked in debug builds, reading the whole chunk index would
+    // otherwise hash every page once per element
+    assert(read_u32(pageStart + pageSize - 4) ==
+           JenkinsLookup3Checksum(
+                   std::string(address() + pageStart, pageSize - 4)));
     size_t elementIndexInPage = i % _numElementsPerPage;
-    return read_u64(pageStart + elementIndexInPage * _entrySize);
+    return pageStart + elementIndexInPage * _entrySize;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #ifndef FIXEDARRAYHEADER_H
 #define FIXEDARRAYHEADER_H
+#include <dectris/neggia/data/H5ChunkRecord.h>
 #include <dectris/neggia/data/H5Object.h>
 #include <string>
 #include <vector>
@@ -10,16 +11,20 @@ class H5FixedArrayDataBlock : public H5Object {
 public:
     H5FixedArrayDataBlock(const char* fileAddress,
                           size_t offset,
+                          uint8_t clientID,
                           size_t entrySize,
                           size_t numEntries,
                           size_t numElementsPerPage);
 
     size_t numElements() const;
     size_t element(int i) const;
+    H5ChunkRecord chunkRecord(int i, uint64_t chunkSize) const;
 
 private:
     void init();
+    size_t entryOffset(int i) const;
 
+    uint8_t _clientID;
     size_t _entrySize;
     size_t _numEntries;
     size_t _numElementsPerPage;
@@ -34,6 +39,10 @@ public:
 
     size_t numElements() const;
     size_t element(int i) const;
+    // The chunk of element i. Arrays of filtered chunks (client ID 1) store
+    // the size and filter mask of each chunk, unfiltered chunks have
+    // chunkSize bytes.
+    H5ChunkRecord chunkRecord(int i, uint64_t chunkSize) const;
 
 private:
     H5FixedArrayDataBlock initDataBlock();
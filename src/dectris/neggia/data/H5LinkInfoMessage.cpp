@@ -35,18 +35,49 @@ uint64_t H5LinkInfoMsg::getBTreeAddress() const {
 
 H5LinkMsg H5LinkInfoMsg::getLinkMessage(const char* rootFileAddress,
                                         const std::string& pathItem) const {
-    size_t btreeAddress = getBTreeAddress();
-    if (btreeAddress == H5_INVALID_ADDRESS) {
-        throw std::out_of_range("Invalid address");
-    }
-    H5BTreeVersion2 btree(rootFileAddress, btreeAddress);
-    H5Object heapRecord(rootFileAddress, btree.getLinkAddressByName(pathItem));
+    H5LinkMsg linkMsg;
+    if (!tryGetLinkMessage(rootFileAddress, pathItem, linkMsg))
+        throw std::out_of_range("item not found");
+    return linkMsg;
+}
+
+bool H5LinkInfoMsg::tryGetLinkMessage(const char* rootFileAddress,
+                                      const std::string& pathItem,
+                                      H5LinkMsg& linkMsg) const {
+    if (!hasDenseStorage())
+        return false;
+    H5BTreeVersion2 btree(rootFileAddress, getBTreeAddress());
+    size_t recordAddress;
+    if (!btree.tryGetLinkAddressByName(pathItem, recordAddress))
+        return false;
+    H5Object heapRecord(rootFileAddress, recordAddress);
     uint32_t heapOffset = heapRecord.read_u32(5);
 
     H5FractalHeap fractalHeap(rootFileAddress, getFractalHeapAddress());
-    H5LinkMsg linkMsg(fractalHeap.getHeapObject(heapOffset));
-    if (linkMsg.linkName() != pathItem) {
-        throw std::out_of_range("item not found");
-    }
-    return linkMsg;
+    H5LinkMsg foundLinkMsg(fractalHeap.getHeapObject(heapOffset));
+    if (foundLinkMsg.linkName() != pathItem)
+        return false;
+    linkMsg = foundLinkMsg;
+    return true;
+}
+
+bool H5LinkInfoMsg::hasDenseStorage() const {
+    return getBTreeAddress() != H5_INVALID_ADDRESS;
+}
+
+std::vector<H5LinkMsg> H5LinkInfoMsg::getLinkMessages(
+        const char* rootFileAddress) const {
+    std::vector<H5LinkMsg> linkMsgs;
+    if (!hasDenseStorage())
+        return linkMsgs;
+    H5BTreeVersion2 btree(rootFileAddress, getBTreeAddress());
+    H5FractalHeap fractalHeap(rootFileAddress, getFractalHeapAddress());
+    linkMsgs.reserve(btree.getNumberOfRecords());
+    btree.forEachRecord([&](size_t recordAddress) {
+        // the heap ID follows the hash of the name
+        H5Object heapRecord(rootFileAddress, recordAddress);
+        linkMsgs.push_back(
+                H5LinkMsg(fractalHeap.getHeapObject(heapRecord.read_u32(5))));
+    });
+    return linkMsgs;
 }
@@ -2,6 +2,7 @@
 
 #ifndef H5LINKINFOMESSAGE_H
 #define H5LINKINFOMESSAGE_H
+#include <vector>
 #include "H5LinkMsg.h"
 #include "H5Object.h"
 
@@ -16,8 +17,19 @@ public:
     uint8_t getFlags() const;
     bool existsMaximumCreationIndex() const;
 
+    // Throws std::out_of_range if the group has no link with the name
     H5LinkMsg getLinkMessage(const char* rootFileAddress,
                              const std::string& pathItem) const;
+    // Like getLinkMessage, returns false if the group has no link with the
+    // name
+    bool tryGetLinkMessage(const char* rootFileAddress,
+                           const std::string& pathItem,
+                           H5LinkMsg& linkMsg) const;
+    // Whether the links are stored in a fractal heap indexed by a B-tree
+    // (dense storage) instead of in link messages of the object header
+    bool hasDenseStorage() const;
+    // All links in dense storage, read in one pass over the B-tree
+    std::vector<H5LinkMsg> getLinkMessages(const char* rootFileAddress) const;
 
 private:
     uint64_t getFractalHeapAddress() const;
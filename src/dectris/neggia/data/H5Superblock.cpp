@@ -22,16 +22,23 @@ uint8_t H5Superblock::version() const {
 }
 
 ResolvedPath H5Superblock::resolve(const H5Path& path) {
+    ResolvedPath resolvedPath;
+    if (!tryResolve(path, resolvedPath))
+        throw std::out_of_range("could not find " + std::string(path));
+    return resolvedPath;
+}
+
+bool H5Superblock::tryResolve(const H5Path& path, ResolvedPath& resolvedPath) {
 #ifdef DEBUG_PARSING
     std::cerr << ">>> superblock version " << (int)version() << " resolving "
               << std::string(path) << "\n";
 #endif
     switch (version()) {
         case 0:
-            return resolveV0(path);
+            return tryResolveV0(path, resolvedPath);
         case 2:
         case 3:
-            return resolveV2(path);
+            return tryResolveV2(path, resolvedPath);
         default:
             throw std::runtime_error("superblock version " +
                                      std::to_string(version()) +
@@ -39,7 +46,8 @@ ResolvedPath H5Superblock::resolve(const H5Path& path) {
     }
 }
 
-ResolvedPath H5Superblock::resolveV0(const H5Path& path) {
+bool H5Superblock::tryResolveV0(const H5Path& path,
+                                ResolvedPath& resolvedPath) {
     // verify header information
     int offsetSize = (int)fileAddress()[13];
     assert(offsetSize == 8);
@@ -51,10 +59,12 @@ ResolvedPath H5Superblock::resolveV0(const H5Path& path) {
     uint64_t DriverInformationBlockAddress =
             *(uint64_t*)(fileAddress() + 24 + 3 * offsetSize);
     assert(DriverInformationBlockAddress == H5_INVALID_ADDRESS);
-    return PathResolverV0(H5SymbolTableEntry(at(24 + 4 * 8))).resolve(path);
+    return PathResolverV0(H5SymbolTableEntry(at(24 + 4 * 8)))
+            .tryResolve(path, resolvedPath);
 }
 
-ResolvedPath H5Superblock::resolveV2(const H5Path& path) {
+bool H5Superblock::tryResolveV2(const H5Path& path,
+                                ResolvedPath& resolvedPath) {
     // verify header information
     int offsetSize = (int)fileAddress()[9];
     assert(offsetSize == 8);
@@ -72,5 +82,5 @@ ResolvedPath H5Superblock::resolveV2(const H5Path& path) {
     assert(extensionAddress == H5_INVALID_ADDRESS);
     uint64_t rootGroupHeaderOffset = *(uint64_t*)(fileAddress() + 36);
     return PathResolverV2(H5ObjectHeader(fileAddress(), rootGroupHeaderOffset))
-            .resolve(path);
+            .tryResolve(path, resolvedPath);
 }
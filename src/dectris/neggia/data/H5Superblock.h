@@ -14,11 +14,14 @@ public:
     H5Superblock(const char* fileAddress);
     uint8_t version() const;
 
+    // Throws std::out_of_range if the path does not exist
     ResolvedPath resolve(const H5Path& path);
+    // Like resolve, returns false if the path does not exist
+    bool tryResolve(const H5Path& path, ResolvedPath& resolvedPath);
 
 private:
-    ResolvedPath resolveV0(const H5Path& path);
-    ResolvedPath resolveV2(const H5Path& path);
+    bool tryResolveV0(const H5Path& path, ResolvedPath& resolvedPath);
+    bool tryResolveV2(const H5Path& path, ResolvedPath& resolvedPath);
 };
 
 #endif  // H5SUPERBLOCK_H
@@ -51,6 +51,14 @@ uint32_t H5SymbolTableEntry::getOffsetToLinkValue() const {
 }
 
 H5SymbolTableEntry H5SymbolTableEntry::find(const std::string& entry) const {
+    H5SymbolTableEntry retVal;
+    if (!tryFind(entry, retVal))
+        throw std::out_of_range("Not found");
+    return retVal;
+}
+
+bool H5SymbolTableEntry::tryFind(const std::string& entry,
+                                 H5SymbolTableEntry& symbolTableEntry) const {
     assert(cacheType() == 1);  // makes sense only for groups
 
     H5BLinkNode bTree(fileAddress(), scratchSpace().read_i64(0));
@@ -68,7 +76,7 @@ H5SymbolTableEntry H5SymbolTableEntry::find(const std::string& entry) const {
             }
         }
         if (!found)
-            throw std::runtime_error("Not found");
+            return false;
     }
 
     {
@@ -81,16 +89,17 @@ H5SymbolTableEntry H5SymbolTableEntry::find(const std::string& entry) const {
             }
         }
         if (i > bTree.entriesUsed())
-            throw std::out_of_range("Not found");
+            return false;
         H5SymbolTableNode symbolTableNode(bTree.child(i - 1));
         for (i = 0; i < symbolTableNode.numberOfSymbols(); ++i) {
             H5SymbolTableEntry retVal(symbolTableNode.entry(i));
             size_t off = retVal.linkNameOffset();
             std::string key = std::string(treeHeap.data(off));
             if (key == entry) {
-                return retVal;
+                symbolTableEntry = retVal;
+                return true;
             }
         }
-        throw std::out_of_range("Not found");
+        return false;
     }
 }
@@ -22,7 +22,11 @@ public:
     uint64_t getAddressOfBTree() const;
     uint64_t getAddressOfHeap() const;
     uint32_t getOffsetToLinkValue() const;
+    // Throws std::out_of_range if the group has no entry with the name
     H5SymbolTableEntry find(const std::string& entry) const;
+    // Like find, returns false if the group has no entry with the name
+    bool tryFind(const std::string& entry,
+                 H5SymbolTableEntry& symbolTableEntry) const;
 };
 
 #endif  // H5SYMBOLTABLEENTRY_H
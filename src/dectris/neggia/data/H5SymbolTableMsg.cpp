@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: MIT
+
+#include "H5SymbolTableMsg.h"
+#include <assert.h>
+#include "H5BLinkNode.h"
+#include "H5SymbolTableNode.h"
+#include "constants.h"
+
+H5SymbolTableMsg::H5SymbolTableMsg(const char* fileAddress, size_t offset)
+      : H5Object(fileAddress, offset) {}
+
+H5SymbolTableMsg::H5SymbolTableMsg(const H5Object& other) : H5Object(other) {}
+
+uint64_t H5SymbolTableMsg::getBTreeAddress() const {
+    return read_u64(0);
+}
+
+uint64_t H5SymbolTableMsg::getLocalHeapAddress() const {
+    return read_u64(8);
+}
+
+H5LocalHeap H5SymbolTableMsg::localHeap() const {
+    return H5LocalHeap(fileAddress(), getLocalHeapAddress());
+}
+
+void H5SymbolTableMsg::forEachEntry(
+        const std::function<void(const H5SymbolTableEntry&)>& entryCallback)
+        const {
+    H5BLinkNode bTree(fileAddress(), getBTreeAddress());
+    assert(bTree.nodeType() == 0);
+    while (bTree.nodeLevel() > 0)
+        bTree = bTree.child(0);
+    while (true) {
+        for (int i = 0; i < bTree.entriesUsed(); ++i) {
+            H5SymbolTableNode symbolTableNode(bTree.child(i));
+            for (int j = 0; j < symbolTableNode.numberOfSymbols(); ++j)
+                entryCallback(symbolTableNode.entry(j));
+        }
+        if (bTree.read_u64(16) == H5_INVALID_ADDRESS)
+            break;
+        bTree = bTree.rightSilbling();
+    }
+}
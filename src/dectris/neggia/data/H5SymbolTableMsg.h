@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef H5SYMBOLTABLEMSG_H
+#define H5SYMBOLTABLEMSG_H
+#include <functional>
+#include "H5LocalHeap.h"
+#include "H5Object.h"
+#include "H5SymbolTableEntry.h"
+
+/// https://support.hdfgroup.org/HDF5/doc/H5.format.html#SymbolTableMessage
+
+class H5SymbolTableMsg : public H5Object {
+public:
+    H5SymbolTableMsg() = default;
+    H5SymbolTableMsg(const char* fileAddress, size_t offset);
+    H5SymbolTableMsg(const H5Object& other);
+    constexpr static unsigned int TYPE_ID = 0x11;
+    uint64_t getBTreeAddress() const;
+    uint64_t getLocalHeapAddress() const;
+    // holds the link names and soft link values of the entries
+    H5LocalHeap localHeap() const;
+    // Calls entryCallback for all entries of the group in the order of their
+    // names, walking the leaves of the B-tree from left to right
+    void forEachEntry(const std::function<void(const H5SymbolTableEntry&)>&
+                              entryCallback) const;
+};
+
+#endif  // H5SYMBOLTABLEMSG_H
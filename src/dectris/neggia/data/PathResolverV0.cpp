@@ -12,12 +12,21 @@
 PathResolverV0::PathResolverV0(const H5SymbolTableEntry& root) : _root(root) {}
 
 ResolvedPath PathResolverV0::resolve(const H5Path& path) {
-    return resolvePathInSymbolTableEntry(_root, path);
+    ResolvedPath resolvedPath;
+    if (!tryResolve(path, resolvedPath))
+        throw std::out_of_range("could not find " + std::string(path));
+    return resolvedPath;
 }
 
-ResolvedPath PathResolverV0::resolvePathInSymbolTableEntry(
+bool PathResolverV0::tryResolve(const H5Path& path,
+                                ResolvedPath& resolvedPath) {
+    return resolvePathInSymbolTableEntry(_root, path, resolvedPath);
+}
+
+bool PathResolverV0::resolvePathInSymbolTableEntry(
         const H5SymbolTableEntry& in,
-        const H5Path& path) {
+        const H5Path& path,
+        ResolvedPath& resolvedPath) {
     assert(in.cacheType() == H5SymbolTableEntry::DATA ||
            in.cacheType() ==
                    H5SymbolTableEntry::GROUP);  // makes sense only for groups
@@ -32,16 +41,15 @@ ResolvedPath PathResolverV0::resolvePathInSymbolTableEntry(
         auto item = *itemIterator;
         if (parentEntry.cacheType() == H5SymbolTableEntry::GROUP) {
             H5SymbolTableEntry stEntry;
-            try {
-                stEntry = parentEntry.find(item);
-            } catch (const std::out_of_range&) {
-                return findPathInObjectHeader(parentEntry,
-                                              parentEntry.objectHeader(), item,
-                                              H5Path(path, itemIterator + 1));
+            if (!parentEntry.tryFind(item, stEntry)) {
+                return findPathInObjectHeader(
+                        parentEntry, parentEntry.objectHeader(), item,
+                        H5Path(path, itemIterator + 1), resolvedPath);
             }
             if (stEntry.cacheType() == H5SymbolTableEntry::LINK) {
                 return findPathInScratchSpace(parentEntry, stEntry,
-                                              H5Path(path, itemIterator + 1));
+                                              H5Path(path, itemIterator + 1),
+                                              resolvedPath);
             } else {
                 parentEntry = stEntry;
                 continue;
@@ -51,47 +59,52 @@ ResolvedPath PathResolverV0::resolvePathInSymbolTableEntry(
                     "Expected GROUP (cache_type = 1) at path item " + item);
         }
     }
-    return ResolvedPath{parentEntry.objectHeader(), {}, {}};
+    resolvedPath = ResolvedPath{parentEntry.objectHeader(), {}, {}};
+    return true;
 }
 
-ResolvedPath PathResolverV0::findPathInScratchSpace(
-        H5SymbolTableEntry parentEntry,
-        H5SymbolTableEntry symbolTableEntry,
-        const H5Path& remainingPath) {
+bool PathResolverV0::findPathInScratchSpace(H5SymbolTableEntry parentEntry,
+                                            H5SymbolTableEntry symbolTableEntry,
+                                            const H5Path& remainingPath,
+                                            ResolvedPath& resolvedPath) {
     size_t targetNameOffset = symbolTableEntry.getOffsetToLinkValue();
     H5LocalHeap treeHeap =
             H5Object(_root.fileAddress(), parentEntry.getAddressOfHeap());
     H5Path targetPath(treeHeap.data(targetNameOffset));
-    return resolvePathInSymbolTableEntry(parentEntry,
-                                         targetPath + remainingPath);
+    return resolvePathInSymbolTableEntry(
+            parentEntry, targetPath + remainingPath, resolvedPath);
 }
 
-ResolvedPath PathResolverV0::findPathInLinkMsg(
-        const H5SymbolTableEntry& parentEntry,
-        const H5LinkMsg& linkMsg,
-        const H5Path& remainingPath) {
+bool PathResolverV0::findPathInLinkMsg(const H5SymbolTableEntry& parentEntry,
+                                       const H5LinkMsg& linkMsg,
+                                       const H5Path& remainingPath,
+                                       ResolvedPath& resolvedPath) {
     switch (linkMsg.linkType()) {
         case H5LinkMsg::SOFT: {
             H5Path targetPath(linkMsg.targetPath());
-            return resolvePathInSymbolTableEntry(parentEntry,
-                                                 targetPath + remainingPath);
+            return resolvePathInSymbolTableEntry(
+                    parentEntry, targetPath + remainingPath, resolvedPath);
         }
         case H5LinkMsg::HARD: {
-            if (std::string(remainingPath).empty())
-                return ResolvedPath{linkMsg.hardLinkObjectHeader(), {}, {}};
+            if (std::string(remainingPath).empty()) {
+                resolvedPath =
+                        ResolvedPath{linkMsg.hardLinkObjectHeader(), {}, {}};
+                return true;
+            }
             return findPathInObjectHeader(
                     parentEntry, linkMsg.hardLinkObjectHeader(),
-                    std::string(remainingPath), H5Path(""));
+                    std::string(remainingPath), H5Path(""), resolvedPath);
         }
         case H5LinkMsg::EXTERNAL: {
             std::string targetFile = linkMsg.targetFile();
             H5Path targetPath(linkMsg.targetPath());
-            return ResolvedPath{
+            resolvedPath = ResolvedPath{
                     {},
                     std::unique_ptr<ResolvedPath::ExternalFile>(
                             new ResolvedPath::ExternalFile{
                                     targetFile, targetPath + remainingPath}),
                     {}};
+            return true;
         }
         default:
             throw std::runtime_error("link type " +
@@ -100,11 +113,12 @@ ResolvedPath PathResolverV0::findPathInLinkMsg(
     }
 }
 
-ResolvedPath PathResolverV0::findPathInObjectHeader(
+bool PathResolverV0::findPathInObjectHeader(
         const H5SymbolTableEntry& parentEntry,
         const H5ObjectHeader& objectHeader,
         const std::string pathItem,
-        const H5Path& remainingPath) {
+        const H5Path& remainingPath,
+        ResolvedPath& resolvedPath) {
     for (size_t i = 0; i < objectHeader.numberOfMessages(); ++i) {
         auto msg = objectHeader.headerMessage(i);
         switch (msg.type) {
@@ -112,20 +126,21 @@ ResolvedPath PathResolverV0::findPathInObjectHeader(
                 H5LinkMsg linkMsg(msg.object);
                 if (linkMsg.linkName() != pathItem)
                     continue;
-                return findPathInLinkMsg(parentEntry, linkMsg, remainingPath);
+                return findPathInLinkMsg(parentEntry, linkMsg, remainingPath,
+                                         resolvedPath);
             }
             case H5LinkInfoMsg::TYPE_ID: {
                 H5LinkInfoMsg linkInfoMsg(msg.object);
-                try {
-                    auto linkMsg = linkInfoMsg.getLinkMessage(
-                            _root.fileAddress(), pathItem);
-                    return findPathInLinkMsg(parentEntry, linkMsg,
-                                             remainingPath);
-                } catch (const std::out_of_range&) {
+                H5LinkMsg linkMsg;
+                if (!linkInfoMsg.tryGetLinkMessage(_root.fileAddress(),
+                                                   pathItem, linkMsg))
+                {
                     continue;
                 }
+                return findPathInLinkMsg(parentEntry, linkMsg, remainingPath,
+                                         resolvedPath);
             }
         }
     }
-    throw std::out_of_range("could not find " + pathItem);
+    return false;
 }
@@ -11,23 +11,30 @@
 class PathResolverV0 {
 public:
     PathResolverV0(const H5SymbolTableEntry& root);
+    // Throws std::out_of_range if the path does not exist
     ResolvedPath resolve(const H5Path& path);
+    // Like resolve, returns false if the path does not exist
+    bool tryResolve(const H5Path& path, ResolvedPath& resolvedPath);
 
 private:
     const H5SymbolTableEntry _root;
 
-    ResolvedPath findPathInObjectHeader(const H5SymbolTableEntry& parentEntry,
-                                        const H5ObjectHeader& objectHeader,
-                                        const std::string pathItem,
-                                        const H5Path& remainingPath);
-    ResolvedPath findPathInLinkMsg(const H5SymbolTableEntry& parentEntry,
-                                   const H5LinkMsg& linkMsg,
-                                   const H5Path& remainingPath);
-    ResolvedPath findPathInScratchSpace(H5SymbolTableEntry parentEntry,
-                                        H5SymbolTableEntry symbolTableEntry,
-                                        const H5Path& remainingPath);
-    ResolvedPath resolvePathInSymbolTableEntry(const H5SymbolTableEntry& in,
-                                               const H5Path& path);
+    bool findPathInObjectHeader(const H5SymbolTableEntry& parentEntry,
+                                const H5ObjectHeader& objectHeader,
+                                const std::string pathItem,
+                                const H5Path& remainingPath,
+                                ResolvedPath& resolvedPath);
+    bool findPathInLinkMsg(const H5SymbolTableEntry& parentEntry,
+                           const H5LinkMsg& linkMsg,
+                           const H5Path& remainingPath,
+                           ResolvedPath& resolvedPath);
+    bool findPathInScratchSpace(H5SymbolTableEntry parentEntry,
+                                H5SymbolTableEntry symbolTableEntry,
+                                const H5Path& remainingPath,
+                                ResolvedPath& resolvedPath);
+    bool resolvePathInSymbolTableEntry(const H5SymbolTableEntry& in,
+                                       const H5Path& path,
+                                       ResolvedPath& resolvedPath);
 };
 
 #endif  // PATH_RESOLVER_V1_H
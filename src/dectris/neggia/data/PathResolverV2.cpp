@@ -3,6 +3,7 @@
 #include "PathResolverV2.h"
 #include <assert.h>
 #include <memory>
+#include <stdexcept>
 #include "H5BTreeVersion2.h"
 #include "H5FractalHeap.h"
 #include "H5LocalHeap.h"
@@ -13,31 +14,46 @@
 PathResolverV2::PathResolverV2(const H5ObjectHeader& root) : _root(root) {}
 
 ResolvedPath PathResolverV2::resolve(const H5Path& path) {
-    return resolvePathInHeader(_root, path);
+    ResolvedPath resolvedPath;
+    if (!tryResolve(path, resolvedPath))
+        throw std::out_of_range("could not find " + std::string(path));
+    return resolvedPath;
 }
 
-ResolvedPath PathResolverV2::resolvePathInHeader(const H5ObjectHeader& in,
-                                                 const H5Path& path) {
+bool PathResolverV2::tryResolve(const H5Path& path,
+                                ResolvedPath& resolvedPath) {
+    return resolvePathInHeader(_root, path, resolvedPath);
+}
+
+bool PathResolverV2::resolvePathInHeader(const H5ObjectHeader& in,
+                                         const H5Path& path,
+                                         ResolvedPath& resolvedPath) {
     H5ObjectHeader parentEntry(path.isAbsolute() ? _root : in);
     for (auto itemIterator = path.begin(); itemIterator != path.end();
          ++itemIterator)
     {
-        auto resolvedPath = findPathInObjectHeader(
-                parentEntry, *itemIterator, H5Path(path, itemIterator + 1));
+        if (!findPathInObjectHeader(parentEntry, *itemIterator,
+                                    H5Path(path, itemIterator + 1),
+                                    resolvedPath))
+        {
+            return false;
+        }
         if (resolvedPath.softLink) {
-            return resolvePathInHeader(parentEntry, *resolvedPath.softLink);
+            H5Path softLink = *resolvedPath.softLink;
+            return resolvePathInHeader(parentEntry, softLink, resolvedPath);
         }
         if (resolvedPath.externalFile) {
             // the object is in a different file which must be opened by
             // upper layer
-            return resolvedPath;
+            return true;
         }
         if ((itemIterator + 1) == path.end()) {
-            return resolvedPath;
+            return true;
         }
         parentEntry = resolvedPath.objectHeader;
     }
-    return ResolvedPath{parentEntry, {}, {}};
+    resolvedPath = ResolvedPath{parentEntry, {}, {}};
+    return true;
 }
 
 ResolvedPath PathResolverV2::findPathInLinkMsg(
@@ -71,10 +87,10 @@ ResolvedPath PathResolverV2::findPathInLinkMsg(
     }
 }
 
-ResolvedPath PathResolverV2::findPathInObjectHeader(
-        const H5ObjectHeader& parentEntry,
-        const std::string pathItem,
-        const H5Path& remainingPath) {
+bool PathResolverV2::findPathInObjectHeader(const H5ObjectHeader& parentEntry,
+                                            const std::string pathItem,
+                                            const H5Path& remainingPath,
+                                            ResolvedPath& resolvedPath) {
     for (size_t i = 0; i < parentEntry.numberOfMessages(); ++i) {
         auto msg = parentEntry.headerMessage(i);
         switch (msg.type) {
@@ -82,20 +98,23 @@ ResolvedPath PathResolverV2::findPathInObjectHeader(
                 H5LinkMsg linkMsg(msg.object);
                 if (linkMsg.linkName() != pathItem)
                     continue;
-                return findPathInLinkMsg(parentEntry, linkMsg, remainingPath);
+                resolvedPath =
+                        findPathInLinkMsg(parentEntry, linkMsg, remainingPath);
+                return true;
             }
             case H5LinkInfoMsg::TYPE_ID: {
                 H5LinkInfoMsg linkInfoMsg(msg.object);
-                try {
-                    auto linkMsg = linkInfoMsg.getLinkMessage(
-                            _root.fileAddress(), pathItem);
-                    return findPathInLinkMsg(parentEntry, linkMsg,
-                                             remainingPath);
-                } catch (const std::out_of_range&) {
+                H5LinkMsg linkMsg;
+                if (!linkInfoMsg.tryGetLinkMessage(_root.fileAddress(),
+                                                   pathItem, linkMsg))
+                {
                     continue;
                 }
+                resolvedPath =
+                        findPathInLinkMsg(parentEntry, linkMsg, remainingPath);
+                return true;
             }
         }
     }
-    throw std::out_of_range("could not find " + pathItem);
+    return false;
 }
@@ -11,16 +11,21 @@
 class PathResolverV2 {
 public:
     PathResolverV2(const H5ObjectHeader& root);
+    // Throws std::out_of_range if the path does not exist
     ResolvedPath resolve(const H5Path& path);
+    // Like resolve, returns false if the path does not exist
+    bool tryResolve(const H5Path& path, ResolvedPath& resolvedPath);
 
 private:
     const H5ObjectHeader _root;
 
-    ResolvedPath resolvePathInHeader(const H5ObjectHeader& in,
-                                     const H5Path& path);
-    ResolvedPath findPathInObjectHeader(const H5ObjectHeader& parentEntry,
-                                        const std::string pathItem,
-                                        const H5Path& remainingPath);
+    bool resolvePathInHeader(const H5ObjectHeader& in,
+                             const H5Path& path,
+                             ResolvedPath& resolvedPath);
+    bool findPathInObjectHeader(const H5ObjectHeader& parentEntry,
+                                const std::string pathItem,
+                                const H5Path& remainingPath,
+                                ResolvedPath& resolvedPath);
     ResolvedPath findPathInLinkMsg(const H5ObjectHeader& parentEntry,
                                    const H5LinkMsg& linkMsg,
                                    const H5Path& remainingPath);
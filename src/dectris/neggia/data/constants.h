@@ -4,5 +4,7 @@
 #define CONSTANTS_H
 
 #define H5_INVALID_ADDRESS 0xffffffffffffffff
+// maximum dimension of unlimited dimensions
+#define H5_UNLIMITED 0xffffffffffffffff
 
 #endif  // CONSTANTS_H
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: MIT
+
+#include "FrameCache.h"
+#include <cstring>
+
+FrameCache::FrameCache(ReadFunction readFrame,
+                       size_t frameSize,
+                       size_t maxBytes)
+      : _readFrame(readFrame), _frameSize(frameSize), _frames(maxBytes) {}
+
+size_t FrameCache::capacity() const {
+    return _frameSize ? _frames.maxBytes() / (_frameSize * sizeof(int)) : 0;
+}
+
+void FrameCache::read(size_t frame, int* data) {
+    ChunkCache::ChunkData frameData =
+            _frames.read(frame, _frameSize * sizeof(int), [&](char* buffer) {
+                _readFrame(frame, (int*)buffer);
+            });
+    std::memcpy(data, frameData->data(), _frameSize * sizeof(int));
+}
+
+size_t FrameCache::hits() const {
+    return _frames.hits();
+}
+
+size_t FrameCache::misses() const {
+    return _frames.misses();
+}
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+#include <dectris/neggia/user/ChunkCache.h>
+#include <functional>
+
+// Keeps the most recently read frames up to a memory budget in a ChunkCache
+// keyed by the frame number
+class FrameCache {
+public:
+    // readFrame(frame, data) writes frameSize pixels of the frame with the
+    // given (zero based) number to data
+    typedef std::function<void(size_t, int*)> ReadFunction;
+
+    FrameCache(ReadFunction readFrame, size_t frameSize, size_t maxBytes);
+
+    // Number of frames which fit into the budget
+    size_t capacity() const;
+    // May be called concurrently. Exceptions of readFrame are rethrown and
+    // the frame is not cached.
+    void read(size_t frame, int* data);
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    ReadFunction _readFrame;
+    size_t _frameSize;
+    ChunkCache _frames;
+};
+
+#endif  // FRAMECACHE_H
@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: MIT
+
+#include "FramePrefetcher.h"
+#include <algorithm>
+#include <cstring>
+
+FramePrefetcher::FramePrefetcher(ReadFunction readFrame,
+                                 size_t frameSize,
+                                 size_t numberOfFrames,
+                                 size_t depth,
+                                 size_t numberOfThreads)
+      : _readFrame(readFrame),
+        _frameSize(frameSize),
+        _numberOfFrames(numberOfFrames),
+        _slots(depth) {
+    for (auto& slot : _slots) {
+        slot.frame = 0;
+        slot.state = State::EMPTY;
+        slot.stale = false;
+        slot.readers = 0;
+        slot.data.reset(new int[frameSize]);
+    }
+    _threadPool.reset(new ThreadPool(numberOfThreads));
+}
+
+FramePrefetcher::~FramePrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto& slot : _slots)
+            slot.stale = true;
+    }
+    // joins the workers; queued decodes of stale slots return immediately
+    _threadPool.reset();
+}
+
+void FramePrefetcher::read(size_t frame, int* data) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    Slot* slot = findSlot(frame);
+    if (slot)
+        ++slot->readers;
+    schedule(frame);
+    if (!slot) {
+        lock.unlock();
+        _readFrame(frame, data);
+        return;
+    }
+    _decoded.wait(lock, [slot] { return slot->state != State::PENDING; });
+    std::exception_ptr error = slot->error;
+    if (!error) {
+        lock.unlock();
+        std::memcpy(data, slot->data.get(), _frameSize * sizeof(int));
+        lock.lock();
+    }
+    if (--slot->readers == 0) {
+        slot->state = State::EMPTY;
+        slot->error = nullptr;
+        schedule(frame);
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+FramePrefetcher::Slot* FramePrefetcher::findSlot(size_t frame) {
+    for (auto& slot : _slots) {
+        if (slot.state != State::EMPTY && !slot.stale && slot.frame == frame)
+            return &slot;
+    }
+    return nullptr;
+}
+
+bool FramePrefetcher::isNear(size_t frame, size_t requestedFrame) const {
+    // frames shortly before the requested one are kept for concurrent readers
+    return frame + _slots.size() >= requestedFrame &&
+           frame <= requestedFrame + _slots.size();
+}
+
+void FramePrefetcher::schedule(size_t requestedFrame) {
+    for (auto& slot : _slots) {
+        if (slot.state == State::EMPTY || slot.readers > 0 ||
+            isNear(slot.frame, requestedFrame))
+        {
+            continue;
+        }
+        if (slot.state == State::PENDING) {
+            slot.stale = true;
+        } else {
+            slot.state = State::EMPTY;
+            slot.error = nullptr;
+        }
+    }
+    size_t endFrame = std::min(requestedFrame + _slots.size() + 1,
+                               _numberOfFrames);
+    for (size_t frame = requestedFrame + 1; frame < endFrame; ++frame) {
+        if (findSlot(frame))
+            continue;
+        auto freeSlot = std::find_if(
+                _slots.begin(), _slots.end(),
+                [](const Slot& slot) { return slot.state == State::EMPTY; });
+        if (freeSlot == _slots.end())
+            return;
+        Slot* slot = &*freeSlot;
+        slot->frame = frame;
+        slot->state = State::PENDING;
+        slot->stale = false;
+        _threadPool->enqueue([this, slot] { decode(slot); });
+    }
+}
+
+void FramePrefetcher::decode(Slot* slot) {
+    size_t frame;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (slot->stale) {
+            slot->state = State::EMPTY;
+            slot->stale = false;
+            _decoded.notify_all();
+            return;
+        }
+        frame = slot->frame;
+    }
+    std::exception_ptr error;
+    try {
+        _readFrame(frame, slot->data.get());
+    } catch (...) {
+        error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (slot->stale) {
+        slot->state = State::EMPTY;
+        slot->stale = false;
+    } else {
+        slot->state = error ? State::FAILED : State::READY;
+        slot->error = error;
+    }
+    _decoded.notify_all();
+}
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef FRAMEPREFETCHER_H
+#define FRAMEPREFETCHER_H
+#include <dectris/neggia/user/ThreadPool.h>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Decodes the frames following the most recently requested one on a small
+// thread pool, so that the next call to read() only has to copy the finished
+// image. Frames which are not prefetched (the first one, or after a jump)
+// are decoded by the calling thread; prefetches which are no longer near the
+// requested frame are discarded.
+class FramePrefetcher {
+public:
+    // readFrame(frame, data) writes frameSize pixels of the frame with the
+    // given (zero based) number to data
+    typedef std::function<void(size_t, int*)> ReadFunction;
+
+    FramePrefetcher(ReadFunction readFrame,
+                    size_t frameSize,
+                    size_t numberOfFrames,
+                    size_t depth,
+                    size_t numberOfThreads);
+    ~FramePrefetcher();
+
+    // May be called concurrently. Exceptions of readFrame are rethrown
+    // by the thread which requests the frame.
+    void read(size_t frame, int* data);
+
+private:
+    enum class State { EMPTY, PENDING, READY, FAILED };
+    struct Slot {
+        size_t frame;
+        State state;
+        // discard the result of the pending decode
+        bool stale;
+        // number of threads waiting for or copying from data
+        size_t readers;
+        std::unique_ptr<int[]> data;
+        std::exception_ptr error;
+    };
+
+    Slot* findSlot(size_t frame);
+    bool isNear(size_t frame, size_t requestedFrame) const;
+    void schedule(size_t requestedFrame);
+    void decode(Slot* slot);
+
+    ReadFunction _readFrame;
+    size_t _frameSize;
+    size_t _numberOfFrames;
+    std::vector<Slot> _slots;
+    std::mutex _mutex;
+    std::condition_variable _decoded;
+    std::unique_ptr<ThreadPool> _threadPool;
+};
+
+#endif  // FRAMEPREFETCHER_H
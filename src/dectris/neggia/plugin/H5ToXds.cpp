@@ -3,18 +3,63 @@
 #include "H5ToXds.h"
 #include <dectris/neggia/user/Dataset.h>
 #include <dectris/neggia/user/H5File.h>
+#include <dectris/neggia/user/ThreadPool.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
+#include <vector>
+#include "FrameCache.h"
+#include "FramePrefetcher.h"
 #include "H5Error.h"
+#include "PixelConversion.h"
+#include "PixelMask.h"
+#include "SidecarIndex.h"
 
 namespace {
 
+struct DataFile {
+    // of the file containing the dataset, after following external links,
+    // empty if the data file could not be opened yet
+    std::string path;
+    size_t objectHeaderAddress;
+    // only kept open if there are few data files, see openDataFiles()
+    std::unique_ptr<Dataset> dataset;
+};
+
+struct FrameChunk {
+    FrameChunk(size_t dataFile, size_t offset, size_t size)
+          : dataFile(dataFile), offset(offset), size(size) {}
+    FrameChunk(const FrameChunk& other)
+          : dataFile(other.dataFile.load()),
+            offset(other.offset),
+            size(other.size) {}
+    FrameChunk& operator=(const FrameChunk& other) {
+        dataFile = other.dataFile.load();
+        offset = other.offset;
+        size = other.size;
+        return *this;
+    }
+    // index into H5DataCache::dataFiles, NO_DATA_FILE if the frame was not
+    // available when the frame table was built. Such frames are looked up
+    // again when they are read, see lookUpFrame(), which sets dataFile after
+    // offset and size.
+    std::atomic<size_t> dataFile;
+    // location of the chunk, relative to the start of the data file
+    size_t offset;
+    size_t size;
+};
+
+constexpr size_t NO_DATA_FILE = std::numeric_limits<size_t>::max();
+
 struct H5DataCache {
     std::string filename;
     H5File h5File;
@@ -22,56 +67,43 @@ struct H5DataCache {
     int dimy;
     int datasize;
     int nframesPerDataset;
-    std::unique_ptr<int32_t[]> mask;
+    PixelMask mask;
     float xpixelSize;
     float ypixelSize;
     bool masterFileOnly;
+    // Data sets with many data files are only opened while a frame is read
+    // from them, H5File keeps the mappings of the recently used ones.
+    // dataFiles[i] holds the frames of /entry/data/data_<i + 1>.
+    mutable std::vector<DataFile> dataFiles;
+    // global frame number (starting from zero) -> chunk of that frame
+    mutable std::vector<FrameChunk> frames;
+    // held while frames which were not available in plugin_get_header are
+    // added to dataFiles and frames
+    mutable std::mutex framesMutex;
+    // only set if NEGGIA_DECODE_THREADS is set, decodes the blocks of each
+    // frame concurrently
+    std::unique_ptr<ThreadPool> decodeThreadPool;
+    // only set if NEGGIA_PREFETCH is set, reads from the members above
+    std::unique_ptr<FramePrefetcher> prefetcher;
+    // only set if NEGGIA_CACHE_MB is set, reads through the prefetcher
+    std::unique_ptr<FrameCache> frameCache;
 };
 
-std::unique_ptr<H5DataCache> GLOBAL_HANDLE = nullptr;
+constexpr int MAX_OPEN_HANDLES = 256;
+// Slots are only set and cleared with OPEN_HANDLES_MUTEX held. Reading a slot
+// does not lock, a handle must not be closed while it is still in use.
+std::atomic<H5DataCache*> OPEN_HANDLES[MAX_OPEN_HANDLES];
+std::mutex OPEN_HANDLES_MUTEX;
+
+// handle used by plugin_open, plugin_get_header, plugin_get_data and
+// plugin_close
+int LEGACY_HANDLE = -1;
 
 void printVersionInfo() {
     std::cout << "This is neggia " << VERSION << " (Copyright Dectris 2020)"
               << std::endl;
 }
 
-template <class T>
-int32_t applyOverflow(T value);
-
-template <>
-int32_t applyOverflow<uint32_t>(uint32_t value) {
-    // XDS uses int32_t pixel values for processing therefore
-    // cannot use any pixels from uint32_t >= 2**31
-    // these values must be set to -1.
-    return (value > INT32_MAX) ? -1 : value;
-}
-
-template <>
-int32_t applyOverflow<uint16_t>(uint16_t value) {
-    // For conversion from uint16_t we only need to set the
-    // 'overflow' value of 0xFFFF to -1. All other values
-    // from uint16_t are allowed.
-    return (value == 0xFFFF) ? -1 : value;
-}
-
-template <>
-int32_t applyOverflow<uint8_t>(uint8_t value) {
-    // For conversion from uint8_t we only need to set the
-    // 'overflow' value of 0xFF to -1. All other values
-    // from uint8_t are allowed.
-    return (value == 0xFF) ? -1 : value;
-}
-
-template <class T>
-void applyMaskAndTransformToInt32(const T* indata,
-                                  int outdata[],
-                                  const int32_t* mask,
-                                  size_t size) {
-    for (size_t j = 0; j < size; ++j) {
-        outdata[j] = mask[j] ? mask[j] : applyOverflow(indata[j]);
-    }
-}
-
 template <class Type>
 Type readFromDataset(const Dataset& d) {
     Type val;
@@ -139,8 +171,10 @@ double readFloatFromDataset(const Dataset& d) {
     }
 }
 
-H5DataCache* getPreopenedDataCache() {
-    H5DataCache* dataCache = GLOBAL_HANDLE.get();
+H5DataCache* getPreopenedDataCache(int handle) {
+    H5DataCache* dataCache = nullptr;
+    if (handle >= 0 && handle < MAX_OPEN_HANDLES)
+        dataCache = OPEN_HANDLES[handle].load();
     if (!dataCache) {
         throw H5Error(-2, "NEGGIA ERROR: NO FILE HAS BEEN OPENED YET");
     }
@@ -154,11 +188,6 @@ size_t correctFrameNumberOffset(int frameNumberStartingFromOne) {
     return (size_t)frameNumberStartingFromOne - 1;
 }
 
-size_t getFrameNumberWithinDataset(size_t globalFrameNumber,
-                                   const H5DataCache* dataCache) {
-    return globalFrameNumber % (size_t)dataCache->nframesPerDataset;
-}
-
 std::string getPathToDataset(size_t globalFrameNumber,
                              const H5DataCache* dataCache) {
     size_t datasetNumber = globalFrameNumber / dataCache->nframesPerDataset + 1;
@@ -176,22 +205,33 @@ std::string getPathToDataset(size_t globalFrameNumber,
     return ss.str();
 }
 
-void setXPixelSize(H5DataCache* dataCache) {
+// Opens an optional dataset. Missing datasets are looked up without throwing
+// an exception, datasets which exist but cannot be opened are an error.
+bool tryOpenDataset(const H5DataCache* dataCache,
+                    const std::string& path,
+                    Dataset& dataset) {
     try {
-        Dataset d(dataCache->h5File, "/entry/instrument/detector/x_pixel_size");
-        dataCache->xpixelSize = (float)readFloatFromDataset(d);
+        return Dataset::tryOpen(dataCache->h5File, path, dataset);
     } catch (const std::out_of_range&) {
-        dataCache->xpixelSize = 0;
+        throw H5Error(-4, "NEGGIA ERROR: CANNOT OPEN " + path + " FROM ",
+                      dataCache->filename);
     }
 }
 
+void setXPixelSize(H5DataCache* dataCache) {
+    Dataset d;
+    if (tryOpenDataset(dataCache, "/entry/instrument/detector/x_pixel_size", d))
+        dataCache->xpixelSize = (float)readFloatFromDataset(d);
+    else
+        dataCache->xpixelSize = 0;
+}
+
 void setYPixelSize(H5DataCache* dataCache) {
-    try {
-        Dataset d(dataCache->h5File, "/entry/instrument/detector/y_pixel_size");
+    Dataset d;
+    if (tryOpenDataset(dataCache, "/entry/instrument/detector/y_pixel_size", d))
         dataCache->ypixelSize = (float)readFloatFromDataset(d);
-    } catch (const std::out_of_range&) {
+    else
         dataCache->ypixelSize = 0;
-    }
 }
 
 template <typename ValueType>
@@ -232,27 +272,27 @@ void setPixelMask(H5DataCache* dataCache) {
         dataCache->dimx = (int)dim[1];
         dataCache->dimy = (int)dim[0];
         size_t s = (size_t)(dataCache->dimx * dataCache->dimy);
-        dataCache->mask.reset(new int32_t[s]);
+        std::vector<int32_t> mask(s);
         if (pixelMask.isSigned()) {
             switch (pixelMask.dataSize()) {
                 case 1: {
                     auto pm = read2D<int8_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.data(), pm.get(), s);
                     break;
                 }
                 case 2: {
                     auto pm = read2D<int16_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.data(), pm.get(), s);
                     break;
                 }
                 case 4: {
                     auto pm = read2D<int32_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.data(), pm.get(), s);
                     break;
                 }
                 case 8: {
                     auto pm = read2D<int64_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.data(), pm.get(), s);
                     break;
                 }
                 default:
@@ -264,22 +304,22 @@ void setPixelMask(H5DataCache* dataCache) {
             switch (pixelMask.dataSize()) {
                 case 1: {
                     auto pm = read2D<uint8_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.data(), pm.get(), s);
                     break;
                 }
                 case 2: {
                     auto pm = read2D<uint16_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.data(), pm.get(), s);
                     break;
                 }
                 case 4: {
                     auto pm = read2D<uint32_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.data(), pm.get(), s);
                     break;
                 }
                 case 8: {
                     auto pm = read2D<uint64_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.data(), pm.get(), s);
                     break;
                 }
                 default:
@@ -288,6 +328,7 @@ void setPixelMask(H5DataCache* dataCache) {
                                   "PIXEL MASK");
             }
         }
+        dataCache->mask = PixelMask(std::move(mask));
     } catch (const std::out_of_range&) {
         throw H5Error(-4, "NEGGIA ERROR: CANNOT READ PIXEL MASK FROM ",
                       dataCache->filename);
@@ -308,15 +349,18 @@ size_t getNumberOfImages(const H5DataCache* dataCache) {
 }
 
 size_t getNumberOfTriggers(const H5DataCache* dataCache) {
-    try {
-        Dataset d(dataCache->h5File,
-                  "/entry/instrument/detector/detectorSpecific/ntrigger");
-        return readNonZeroUint(d);
-    } catch (const std::out_of_range&) {
+    Dataset d;
+    if (!tryOpenDataset(dataCache,
+                        "/entry/instrument/detector/detectorSpecific/ntrigger",
+                        d))
+    {
         std::cerr << "NEGGIA WARNING: "
                      "/entry/instrument/detector/detectorSpecific/ntrigger not "
                      "found, using ntrigger = 1\n";
         return 1;
+    }
+    try {
+        return readNonZeroUint(d);
     } catch (const H5Error&) {
         throw H5Error(-4, "NEGGIA ERROR: UNSUPPORTED DATATYPE FOR N_TRIGGER");
     }
@@ -344,63 +388,336 @@ void setNFramesPerDatasetFromPath(H5DataCache* dataCache,
 }
 
 void setNFramesPerDataset(H5DataCache* dataCache) {
-    try {
-        setNFramesPerDatasetFromPath(dataCache, "/entry/data/data_000001");
-        dataCache->masterFileOnly = false;
-    } catch (const H5Error&) {
-        setNFramesPerDatasetFromPath(dataCache, "/entry/data/data");
-        dataCache->masterFileOnly = true;
-    }
+    // master files without data files keep the frames in /entry/data/data
+    dataCache->masterFileOnly =
+            !dataCache->h5File.exists(H5Path("/entry/data/data_000001"));
+    setNFramesPerDatasetFromPath(
+            dataCache, dataCache->masterFileOnly ? "/entry/data/data"
+                                                 : "/entry/data/data_000001");
 }
 
+// converts count pixels starting at pixel first
 void applyMaskAndTransformToInt32(const H5DataCache* dataCache,
                                   const void* indata,
-                                  int outdata[]) {
+                                  int outdata[],
+                                  size_t first,
+                                  size_t count) {
     switch (dataCache->datasize) {
         case 1:
-            applyMaskAndTransformToInt32((const uint8_t*)indata, outdata,
-                                         dataCache->mask.get(),
-                                         dataCache->dimx * dataCache->dimy);
+            transformToInt32((const uint8_t*)indata, outdata + first, count);
             break;
         case 2:
-            applyMaskAndTransformToInt32((const uint16_t*)indata, outdata,
-                                         dataCache->mask.get(),
-                                         dataCache->dimx * dataCache->dimy);
+            transformToInt32((const uint16_t*)indata, outdata + first, count);
             break;
         case 4:
-            applyMaskAndTransformToInt32((const uint32_t*)indata, outdata,
-                                         dataCache->mask.get(),
-                                         dataCache->dimx * dataCache->dimy);
+            transformToInt32((const uint32_t*)indata, outdata + first, count);
             break;
         default: {
             throw H5Error(-3, "NEGGIA ERROR: DATATYPE NOT SUPPORTED");
         }
     }
+    dataCache->mask.apply(outdata + first, first, count);
+}
+
+void setFrameTable(H5DataCache* dataCache, size_t numberOfFrames) {
+    size_t nframesPerDataset = dataCache->nframesPerDataset;
+    dataCache->dataFiles.clear();
+    dataCache->dataFiles.resize((numberOfFrames + nframesPerDataset - 1) /
+                                nframesPerDataset);
+    dataCache->frames.assign(numberOfFrames, FrameChunk{NO_DATA_FILE, 0, 0});
+    for (size_t firstFrame = 0; firstFrame < numberOfFrames;
+         firstFrame += nframesPerDataset)
+    {
+        // Frames of datasets which cannot be opened yet stay unresolved and
+        // are looked up again when they are requested.
+        Dataset dataset;
+        try {
+            if (!Dataset::tryOpen(dataCache->h5File,
+                                  getPathToDataset(firstFrame, dataCache),
+                                  dataset))
+            {
+                continue;
+            }
+        } catch (const H5Error&) {
+            continue;
+        } catch (const std::out_of_range&) {
+            continue;
+        }
+        size_t dataFileIndex = firstFrame / nframesPerDataset;
+        const char* fileAddress = dataset.h5File().fileAddress();
+        size_t nframes = std::min(dataset.dim()[0],
+                                  (size_t)dataCache->nframesPerDataset);
+        for (size_t i = 0; i < nframes && firstFrame + i < numberOfFrames;
+             ++i)
+        {
+            try {
+                auto chunk = dataset.chunkData({i, 0, 0});
+                dataCache->frames[firstFrame + i] = FrameChunk{
+                        dataFileIndex, (size_t)(chunk.data - fileAddress),
+                        chunk.size};
+            } catch (const std::out_of_range&) {
+                // chunk not written (yet)
+            }
+        }
+        dataCache->dataFiles[dataFileIndex] = DataFile{
+                dataset.h5File().path(), dataset.objectHeaderAddress(),
+                nullptr};
+    }
+}
+
+// Opening a data file for every frame costs a few microseconds, which is
+// only worth it if not all data files can stay mapped.
+void openDataFiles(H5DataCache* dataCache) {
+    if (dataCache->dataFiles.size() > H5File::maxMappedFiles())
+        return;
+    for (auto& dataFile : dataCache->dataFiles) {
+        if (dataFile.path.empty())
+            continue;
+        try {
+            dataFile.dataset.reset(new Dataset(H5File(dataFile.path),
+                                               dataFile.objectHeaderAddress));
+        } catch (const std::out_of_range&) {
+            // reported when a frame is read from it
+        }
+    }
+}
+
+// Looks up the chunk of a frame which was not available in
+// plugin_get_header, e.g. while the data files are still being written, in
+// dataset. The frame is added to the frame table if its data file is opened
+// for every frame, a data file which stays open may have been mapped before
+// the frame was written.
+Dataset::ConstDataPointer lookUpFrame(size_t globalFrameNumber,
+                                      const H5DataCache* dataCache,
+                                      Dataset& dataset) {
+    dataset = Dataset(dataCache->h5File,
+                      getPathToDataset(globalFrameNumber, dataCache));
+    auto chunk = dataset.chunkData(
+            {globalFrameNumber % dataCache->nframesPerDataset, 0, 0});
+    size_t dataFileIndex = globalFrameNumber / dataCache->nframesPerDataset;
+    std::lock_guard<std::mutex> lock(dataCache->framesMutex);
+    FrameChunk& frameChunk = dataCache->frames[globalFrameNumber];
+    if (frameChunk.dataFile != NO_DATA_FILE ||
+        dataFileIndex >= dataCache->dataFiles.size())
+    {
+        return chunk;
+    }
+    DataFile& dataFile = dataCache->dataFiles[dataFileIndex];
+    if (dataFile.dataset)
+        return chunk;
+    if (dataFile.path.empty()) {
+        dataFile.path = dataset.h5File().path();
+        dataFile.objectHeaderAddress = dataset.objectHeaderAddress();
+    }
+    frameChunk.offset = (size_t)(chunk.data - dataset.h5File().fileAddress());
+    frameChunk.size = chunk.size;
+    frameChunk.dataFile.store(dataFileIndex, std::memory_order_release);
+    return chunk;
 }
 
 void readDataset(int* frame_number,
                  int data_array[],
                  const H5DataCache* dataCache) {
     size_t globalFrameNumber = correctFrameNumberOffset(*frame_number);
-    std::string pathToDataset = getPathToDataset(globalFrameNumber, dataCache);
+    if (globalFrameNumber >= dataCache->frames.size())
+        throw H5Error(-2, "NEGGIA ERROR: CANNOT OPEN FRAME ", *frame_number);
+    const FrameChunk& frameChunk = dataCache->frames[globalFrameNumber];
+    size_t dataFileIndex = frameChunk.dataFile.load(std::memory_order_acquire);
     try {
-        Dataset dataset(dataCache->h5File, pathToDataset);
-        size_t totNumberOfDatasets = dataset.dim()[0];
-        size_t datasetFrameNumber =
-                getFrameNumberWithinDataset(globalFrameNumber, dataCache);
-        if (datasetFrameNumber >= totNumberOfDatasets)
-            throw std::out_of_range("frame_number out of range");
-        std::unique_ptr<char[]> buffer(
-                new char[dataCache->dimx * dataCache->dimy *
-                         dataCache->datasize]);
-        dataset.read(buffer.get(),
-                     std::vector<size_t>({datasetFrameNumber, 0, 0}));
-        applyMaskAndTransformToInt32(dataCache, buffer.get(), data_array);
+        const Dataset* dataset = nullptr;
+        Dataset reopenedDataset;
+        Dataset::ConstDataPointer chunk;
+        if (dataFileIndex == NO_DATA_FILE) {
+            chunk = lookUpFrame(globalFrameNumber, dataCache, reopenedDataset);
+            dataset = &reopenedDataset;
+        } else {
+            const DataFile& dataFile = dataCache->dataFiles[dataFileIndex];
+            dataset = dataFile.dataset.get();
+            if (!dataset) {
+                reopenedDataset = Dataset(H5File(dataFile.path),
+                                          dataFile.objectHeaderAddress);
+                dataset = &reopenedDataset;
+            }
+            chunk = Dataset::ConstDataPointer{
+                    dataset->h5File().fileAddress() + frameChunk.offset,
+                    frameChunk.size};
+        }
+        // Each decoded block is converted while it is still in the cache,
+        // directly into data_array.
+        auto convertBlock = [dataCache, data_array](const void* block,
+                                                    size_t first,
+                                                    size_t count) {
+            applyMaskAndTransformToInt32(dataCache, block, data_array, first,
+                                         count);
+        };
+        if (dataCache->decodeThreadPool) {
+            dataset->readChunkBlocks(chunk, convertBlock,
+                                     *dataCache->decodeThreadPool);
+        } else {
+            dataset->readChunkBlocks(chunk, convertBlock);
+        }
     } catch (const std::out_of_range&) {
         throw H5Error(-2, "NEGGIA ERROR: CANNOT OPEN FRAME ", *frame_number);
     }
 }
 
+size_t readSizeFromEnvironment(const char* name, size_t defaultValue) {
+    const char* value = std::getenv(name);
+    if (!value || !*value)
+        return defaultValue;
+    char* end;
+    unsigned long result = std::strtoul(value, &end, 10);
+    if (*end != '\0') {
+        std::cerr << "NEGGIA WARNING: IGNORING INVALID VALUE " << value
+                  << " OF " << name << std::endl;
+        return defaultValue;
+    }
+    return result;
+}
+
+// NEGGIA_MAX_MAPPED_FILES=n keeps up to n recently used data files mapped
+// (default 64). Sweeps with thousands of data files would otherwise exhaust
+// the number of mappings allowed per process.
+void setMaxMappedFiles() {
+    H5File::setMaxMappedFiles(readSizeFromEnvironment(
+            "NEGGIA_MAX_MAPPED_FILES", H5File::maxMappedFiles()));
+}
+
+// NEGGIA_INDEX=1 stores the header data and the frame table next to the
+// master file and reuses them as long as none of the files changed.
+bool isSidecarIndexEnabled() {
+    return readSizeFromEnvironment("NEGGIA_INDEX", 0) != 0;
+}
+
+bool loadSidecarIndex(H5DataCache* dataCache) {
+    SidecarIndex index;
+    if (!readSidecarIndex(dataCache->filename, &index))
+        return false;
+    dataCache->dimx = index.dimx;
+    dataCache->dimy = index.dimy;
+    dataCache->datasize = index.datasize;
+    dataCache->nframesPerDataset = index.nframesPerDataset;
+    dataCache->masterFileOnly = index.masterFileOnly;
+    dataCache->xpixelSize = index.xpixelSize;
+    dataCache->ypixelSize = index.ypixelSize;
+    dataCache->mask = PixelMask(std::move(index.mask));
+    dataCache->dataFiles.clear();
+    for (const auto& dataFile : index.dataFiles) {
+        dataCache->dataFiles.push_back(
+                DataFile{dataFile.path, dataFile.objectHeaderAddress, nullptr});
+    }
+    dataCache->frames.clear();
+    for (const auto& frame : index.frames) {
+        dataCache->frames.push_back(
+                FrameChunk{frame.dataFile, frame.offset, frame.size});
+    }
+    return true;
+}
+
+// Frame tables with missing frames, e.g. while data files are still being
+// written, are not stored.
+void saveSidecarIndex(const H5DataCache* dataCache) {
+    SidecarIndex index;
+    index.dimx = dataCache->dimx;
+    index.dimy = dataCache->dimy;
+    index.datasize = dataCache->datasize;
+    index.nframesPerDataset = dataCache->nframesPerDataset;
+    index.masterFileOnly = dataCache->masterFileOnly;
+    index.xpixelSize = dataCache->xpixelSize;
+    index.ypixelSize = dataCache->ypixelSize;
+    for (const auto& dataFile : dataCache->dataFiles) {
+        index.dataFiles.push_back(SidecarIndex::DataFile{
+                dataFile.path, dataFile.objectHeaderAddress});
+    }
+    for (const auto& frame : dataCache->frames) {
+        if (frame.dataFile == NO_DATA_FILE)
+            return;
+        index.frames.push_back(SidecarIndex::Frame{
+                (uint32_t)frame.dataFile, frame.offset, frame.size});
+    }
+    index.mask.assign((size_t)dataCache->dimx * dataCache->dimy, 0);
+    dataCache->mask.apply(index.mask.data(), 0, index.mask.size());
+    if (!writeSidecarIndex(dataCache->filename, index)) {
+        std::cerr << "NEGGIA WARNING: CANNOT WRITE INDEX "
+                  << sidecarIndexPath(dataCache->filename) << std::endl;
+    }
+}
+
+// NEGGIA_DECODE_THREADS=n decodes the blocks of a frame on the calling thread
+// and n worker threads, for programs which need single frames quickly
+void setDecodeThreadPool(H5DataCache* dataCache) {
+    size_t numberOfThreads =
+            readSizeFromEnvironment("NEGGIA_DECODE_THREADS", 0);
+    if (numberOfThreads == 0)
+        return;
+    dataCache->decodeThreadPool.reset(new ThreadPool(numberOfThreads));
+}
+
+// NEGGIA_PREFETCH=k decodes up to k frames ahead of the last requested frame
+// on NEGGIA_THREADS worker threads (default 1). Each prefetched frame needs
+// nx * ny * 4 bytes of memory.
+void setPrefetcher(H5DataCache* dataCache) {
+    size_t depth = readSizeFromEnvironment("NEGGIA_PREFETCH", 0);
+    if (depth == 0 || dataCache->frames.empty())
+        return;
+    size_t numberOfThreads = readSizeFromEnvironment("NEGGIA_THREADS", 1);
+    const H5DataCache* readOnlyDataCache = dataCache;
+    dataCache->prefetcher.reset(new FramePrefetcher(
+            [readOnlyDataCache](size_t frame, int* data) {
+                int frameNumber = (int)frame + 1;
+                readDataset(&frameNumber, data, readOnlyDataCache);
+            },
+            (size_t)dataCache->dimx * dataCache->dimy,
+            dataCache->frames.size(), depth, numberOfThreads));
+}
+
+void readUncachedFrame(const H5DataCache* dataCache,
+                       size_t frame,
+                       int data_array[]) {
+    if (dataCache->prefetcher) {
+        dataCache->prefetcher->read(frame, data_array);
+    } else {
+        int frameNumber = (int)frame + 1;
+        readDataset(&frameNumber, data_array, dataCache);
+    }
+}
+
+// NEGGIA_CACHE_MB=m keeps up to m MiB of the most recently read frames, for
+// programs which read frames several times
+void setFrameCache(H5DataCache* dataCache) {
+    size_t megabytes = readSizeFromEnvironment("NEGGIA_CACHE_MB", 0);
+    if (megabytes == 0 || dataCache->frames.empty())
+        return;
+    const H5DataCache* readOnlyDataCache = dataCache;
+    dataCache->frameCache.reset(new FrameCache(
+            [readOnlyDataCache](size_t frame, int* data) {
+                readUncachedFrame(readOnlyDataCache, frame, data);
+            },
+            (size_t)dataCache->dimx * dataCache->dimy, megabytes << 20));
+    if (dataCache->frameCache->capacity() == 0) {
+        std::cerr << "NEGGIA WARNING: NEGGIA_CACHE_MB IS TOO SMALL FOR ONE "
+                     "FRAME, FRAMES ARE NOT CACHED"
+                  << std::endl;
+        dataCache->frameCache.reset();
+    }
+}
+
+void readFrame(const H5DataCache* dataCache, size_t frame, int data_array[]) {
+    if (dataCache->frameCache) {
+        dataCache->frameCache->read(frame, data_array);
+    } else {
+        readUncachedFrame(dataCache, frame, data_array);
+    }
+}
+
+void printFrameCacheStatistics(const H5DataCache* dataCache) {
+    if (!dataCache->frameCache)
+        return;
+    std::cout << "NEGGIA FRAME CACHE: " << dataCache->frameCache->hits()
+              << " HITS, " << dataCache->frameCache->misses() << " MISSES"
+              << std::endl;
+}
+
 void setInfoArray(int info[1024]) {
     info[0] = DECTRIS_H5TOXDS_CUSTOMER_ID;        // Customer ID [1:Dectris]
     info[1] = DECTRIS_H5TOXDS_VERSION_MAJOR;      // Version  [Major]
@@ -415,10 +732,15 @@ std::unique_ptr<H5DataCache> retVal(new H5DataCache);
 
 extern "C" {
 
-void plugin_open(const char* filename, int info_array[1024], int* error_flag) {
+void plugin_open_handle(const char* filename,
+                        int* handle,
+                        int info_array[1024],
+                        int* error_flag) {
     setInfoArray(info_array);
     *error_flag = 0;
+    *handle = -1;
     printVersionInfo();
+    setMaxMappedFiles();
     std::unique_ptr<H5DataCache> dataCache(new H5DataCache);
     try {
         dataCache->filename = filename;
@@ -428,40 +750,58 @@ void plugin_open(const char* filename, int info_array[1024], int* error_flag) {
         *error_flag = -4;
         return;
     }
-    if (GLOBAL_HANDLE) {
-        std::cerr << "NEGGIA ERROR: CAN ONLY OPEN ONE FILE AT A TIME "
-                  << std::endl;
-        *error_flag = -4;
-        return;
-    } else {
-        GLOBAL_HANDLE = std::move(dataCache);
+    std::lock_guard<std::mutex> lock(OPEN_HANDLES_MUTEX);
+    for (int i = 0; i < MAX_OPEN_HANDLES; ++i) {
+        if (!OPEN_HANDLES[i].load()) {
+            OPEN_HANDLES[i].store(dataCache.release());
+            *handle = i;
+            return;
+        }
     }
+    std::cerr << "NEGGIA ERROR: TOO MANY OPEN FILES" << std::endl;
+    *error_flag = -4;
 }
 
-void plugin_get_header(int* nx,
-                       int* ny,
-                       int* nbytes,
-                       float* qx,
-                       float* qy,
-                       int* number_of_frames,
-                       int info[1024],
-                       int* error_flag) {
+void plugin_get_header_handle(int* handle,
+                              int* nx,
+                              int* ny,
+                              int* nbytes,
+                              float* qx,
+                              float* qy,
+                              int* number_of_frames,
+                              int info[1024],
+                              int* error_flag) {
     setInfoArray(info);
     try {
-        H5DataCache* dataCache = getPreopenedDataCache();
-        setXPixelSize(dataCache);
-        setYPixelSize(dataCache);
-        setPixelMask(dataCache);
-        size_t nimages = getNumberOfImages(dataCache);
-        size_t ntrigger = getNumberOfTriggers(dataCache);
-        setNFramesPerDataset(dataCache);
+        H5DataCache* dataCache = getPreopenedDataCache(*handle);
+        // the frame cache and the prefetcher read from the data cache which
+        // is updated below
+        dataCache->frameCache.reset();
+        dataCache->prefetcher.reset();
+        dataCache->decodeThreadPool.reset();
+        bool useIndex = isSidecarIndexEnabled();
+        if (!useIndex || !loadSidecarIndex(dataCache)) {
+            setXPixelSize(dataCache);
+            setYPixelSize(dataCache);
+            setPixelMask(dataCache);
+            size_t nimages = getNumberOfImages(dataCache);
+            size_t ntrigger = getNumberOfTriggers(dataCache);
+            setNFramesPerDataset(dataCache);
+            setFrameTable(dataCache, nimages * ntrigger);
+            if (useIndex)
+                saveSidecarIndex(dataCache);
+        }
+        openDataFiles(dataCache);
+        setDecodeThreadPool(dataCache);
+        setPrefetcher(dataCache);
+        setFrameCache(dataCache);
 
         *nx = dataCache->dimx;
         *ny = dataCache->dimy;
         *nbytes = dataCache->datasize;
         *qx = dataCache->xpixelSize;
         *qy = dataCache->ypixelSize;
-        *number_of_frames = (int)(nimages * ntrigger);
+        *number_of_frames = (int)dataCache->frames.size();
 
     } catch (const H5Error& error) {
         std::cerr << error.what() << std::endl;
@@ -472,16 +812,19 @@ void plugin_get_header(int* nx,
     return;
 }
 
-void plugin_get_data(int* frame_number,
-                     int* nx,
-                     int* ny,
-                     int data_array[],
-                     int info_array[1024],
-                     int* error_flag) {
+void plugin_get_data_handle(int* handle,
+                            int* frame_number,
+                            int* nx,
+                            int* ny,
+                            int data_array[],
+                            int info_array[1024],
+                            int* error_flag) {
     setInfoArray(info_array);
     try {
-        H5DataCache* dataCache = getPreopenedDataCache();
-        readDataset(frame_number, data_array, dataCache);
+        // the data cache is not modified after plugin_get_header_handle
+        const H5DataCache* dataCache = getPreopenedDataCache(*handle);
+        readFrame(dataCache, correctFrameNumberOffset(*frame_number),
+                  data_array);
     } catch (const H5Error& error) {
         std::cerr << error.what() << std::endl;
         *error_flag = error.getErrorCode();
@@ -490,8 +833,59 @@ void plugin_get_data(int* frame_number,
     *error_flag = 0;
 }
 
+void plugin_close_handle(int* handle, int* error_flag) {
+    std::unique_ptr<H5DataCache> dataCache;
+    if (*handle >= 0 && *handle < MAX_OPEN_HANDLES) {
+        std::lock_guard<std::mutex> lock(OPEN_HANDLES_MUTEX);
+        dataCache.reset(OPEN_HANDLES[*handle].exchange(nullptr));
+    }
+    if (!dataCache) {
+        std::cerr << "NEGGIA ERROR: NO FILE HAS BEEN OPENED YET" << std::endl;
+        *error_flag = -2;
+        return;
+    }
+    printFrameCacheStatistics(dataCache.get());
+    *error_flag = 0;
+}
+
+void plugin_open(const char* filename, int info_array[1024], int* error_flag) {
+    if (LEGACY_HANDLE >= 0) {
+        setInfoArray(info_array);
+        printVersionInfo();
+        std::cerr << "NEGGIA ERROR: CAN ONLY OPEN ONE FILE AT A TIME "
+                  << std::endl;
+        *error_flag = -4;
+        return;
+    }
+    plugin_open_handle(filename, &LEGACY_HANDLE, info_array, error_flag);
+}
+
+void plugin_get_header(int* nx,
+                       int* ny,
+                       int* nbytes,
+                       float* qx,
+                       float* qy,
+                       int* number_of_frames,
+                       int info[1024],
+                       int* error_flag) {
+    plugin_get_header_handle(&LEGACY_HANDLE, nx, ny, nbytes, qx, qy,
+                             number_of_frames, info, error_flag);
+}
+
+void plugin_get_data(int* frame_number,
+                     int* nx,
+                     int* ny,
+                     int data_array[],
+                     int info_array[1024],
+                     int* error_flag) {
+    plugin_get_data_handle(&LEGACY_HANDLE, frame_number, nx, ny, data_array,
+                           info_array, error_flag);
+}
+
 void plugin_close(int* error_flag) {
-    GLOBAL_HANDLE.reset();
+    if (LEGACY_HANDLE >= 0)
+        plugin_close_handle(&LEGACY_HANDLE, error_flag);
+    LEGACY_HANDLE = -1;
 }
 
 }  // extern "C"
@@ -25,6 +25,9 @@ void plugin_get_header(int* nx,
                        int info[1024],
                        int* error_flag);
 
+// plugin_get_data may be called concurrently from several threads once
+// plugin_get_header has returned. plugin_open, plugin_get_header and
+// plugin_close must not run concurrently with any other plugin call.
 void plugin_get_data(int* frame_number,
                      int* nx,
                      int* ny,
@@ -34,6 +37,37 @@ void plugin_get_data(int* frame_number,
 
 void plugin_close(int* error_flag);
 
+// Extension of the XDS interface for programs which read several files at the
+// same time. plugin_open_handle returns a handle which is passed to the other
+// functions, each handle has its own header data and caches. Handles may be
+// opened and closed concurrently with calls for other handles; the rules
+// above apply to calls for the same handle. The functions without handle use
+// a handle of their own.
+void plugin_open_handle(const char* filename,
+                        int* handle,
+                        int info_array[1024],
+                        int* error_flag);
+
+void plugin_get_header_handle(int* handle,
+                              int* nx,
+                              int* ny,
+                              int* nbytes,
+                              float* qx,
+                              float* qy,
+                              int* number_of_frames,
+                              int info[1024],
+                              int* error_flag);
+
+void plugin_get_data_handle(int* handle,
+                            int* frame_number,
+                            int* nx,
+                            int* ny,
+                            int data_array[],
+                            int info_array[1024],
+                            int* error_flag);
+
+void plugin_close_handle(int* handle, int* error_flag);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: MIT
+
+#include "PixelConversion.h"
+#include <algorithm>
+#include <climits>
+
+// The vector kernels are compiled with function specific target attributes
+// and selected at runtime, so the library still runs on CPUs without them.
+#if (defined(__x86_64__) || defined(__i386__)) && \
+        (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define NEGGIA_X86_KERNELS
+#include <immintrin.h>
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace {
+
+template <class T>
+int32_t applyOverflow(T value);
+
+template <>
+int32_t applyOverflow<uint32_t>(uint32_t value) {
+    // XDS uses int32_t pixel values for processing therefore
+    // cannot use any pixels from uint32_t >= 2**31
+    // these values must be set to -1.
+    return (value > INT32_MAX) ? -1 : value;
+}
+
+template <>
+int32_t applyOverflow<uint16_t>(uint16_t value) {
+    // For conversion from uint16_t we only need to set the
+    // 'overflow' value of 0xFFFF to -1. All other values
+    // from uint16_t are allowed.
+    return (value == 0xFFFF) ? -1 : value;
+}
+
+template <>
+int32_t applyOverflow<uint8_t>(uint8_t value) {
+    // For conversion from uint8_t we only need to set the
+    // 'overflow' value of 0xFF to -1. All other values
+    // from uint8_t are allowed.
+    return (value == 0xFF) ? -1 : value;
+}
+
+template <class T>
+void convertScalar(const T* indata, int outdata[], size_t size) {
+    for (size_t j = 0; j < size; ++j) {
+        outdata[j] = applyOverflow(indata[j]);
+    }
+}
+
+#ifdef NEGGIA_X86_KERNELS
+
+// For uint8_t and uint16_t input the overflow value is compared after zero
+// extension to 32 bit; uint32_t values above INT32_MAX are negative as
+// int32_t and are or-ed with their sign.
+
+TARGET("sse2")
+void storeSse2(int* outdata, __m128i value) {
+    _mm_storeu_si128((__m128i*)outdata, value);
+}
+
+TARGET("sse2")
+__m128i applyOverflowSse2(__m128i value, __m128i overflow) {
+    return _mm_or_si128(value, _mm_cmpeq_epi32(value, overflow));
+}
+
+TARGET("sse2")
+void convertSse2(const uint8_t* indata, int outdata[], size_t size) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i overflow = _mm_set1_epi32(0xFF);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i v8 = _mm_loadu_si128((const __m128i*)(indata + i));
+        __m128i lo16 = _mm_unpacklo_epi8(v8, zero);
+        __m128i hi16 = _mm_unpackhi_epi8(v8, zero);
+        storeSse2(outdata + i,
+                  applyOverflowSse2(_mm_unpacklo_epi16(lo16, zero), overflow));
+        storeSse2(outdata + i + 4,
+                  applyOverflowSse2(_mm_unpackhi_epi16(lo16, zero), overflow));
+        storeSse2(outdata + i + 8,
+                  applyOverflowSse2(_mm_unpacklo_epi16(hi16, zero), overflow));
+        storeSse2(outdata + i + 12,
+                  applyOverflowSse2(_mm_unpackhi_epi16(hi16, zero), overflow));
+    }
+    convertScalar(indata + i, outdata + i, size - i);
+}
+
+TARGET("sse2")
+void convertSse2(const uint16_t* indata, int outdata[], size_t size) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i overflow = _mm_set1_epi32(0xFFFF);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m128i v16 = _mm_loadu_si128((const __m128i*)(indata + i));
+        storeSse2(outdata + i,
+                  applyOverflowSse2(_mm_unpacklo_epi16(v16, zero), overflow));
+        storeSse2(outdata + i + 4,
+                  applyOverflowSse2(_mm_unpackhi_epi16(v16, zero), overflow));
+    }
+    convertScalar(indata + i, outdata + i, size - i);
+}
+
+TARGET("sse2")
+void convertSse2(const uint32_t* indata, int outdata[], size_t size) {
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        __m128i value = _mm_loadu_si128((const __m128i*)(indata + i));
+        value = _mm_or_si128(value, _mm_srai_epi32(value, 31));
+        storeSse2(outdata + i, value);
+    }
+    convertScalar(indata + i, outdata + i, size - i);
+}
+
+TARGET("avx2")
+void storeAvx2(int* outdata, __m256i value) {
+    _mm256_storeu_si256((__m256i*)outdata, value);
+}
+
+TARGET("avx2")
+__m256i applyOverflowAvx2(__m256i value, __m256i overflow) {
+    return _mm256_or_si256(value, _mm256_cmpeq_epi32(value, overflow));
+}
+
+TARGET("avx2")
+void convertAvx2(const uint8_t* indata, int outdata[], size_t size) {
+    const __m256i overflow = _mm256_set1_epi32(0xFF);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256i value = _mm256_cvtepu8_epi32(
+                _mm_loadl_epi64((const __m128i*)(indata + i)));
+        storeAvx2(outdata + i, applyOverflowAvx2(value, overflow));
+    }
+    convertScalar(indata + i, outdata + i, size - i);
+}
+
+TARGET("avx2")
+void convertAvx2(const uint16_t* indata, int outdata[], size_t size) {
+    const __m256i overflow = _mm256_set1_epi32(0xFFFF);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256i value = _mm256_cvtepu16_epi32(
+                _mm_loadu_si128((const __m128i*)(indata + i)));
+        storeAvx2(outdata + i, applyOverflowAvx2(value, overflow));
+    }
+    convertScalar(indata + i, outdata + i, size - i);
+}
+
+TARGET("avx2")
+void convertAvx2(const uint32_t* indata, int outdata[], size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256i value = _mm256_loadu_si256((const __m256i*)(indata + i));
+        value = _mm256_or_si256(value, _mm256_srai_epi32(value, 31));
+        storeAvx2(outdata + i, value);
+    }
+    convertScalar(indata + i, outdata + i, size - i);
+}
+
+TARGET("avx512f")
+void storeAvx512(int* outdata, __m512i value) {
+    _mm512_storeu_si512(outdata, value);
+}
+
+TARGET("avx512f")
+__m512i applyOverflowAvx512(__m512i value, __m512i overflow) {
+    return _mm512_mask_mov_epi32(value,
+                                 _mm512_cmpeq_epi32_mask(value, overflow),
+                                 _mm512_set1_epi32(-1));
+}
+
+TARGET("avx512f")
+void convertAvx512(const uint8_t* indata, int outdata[], size_t size) {
+    const __m512i overflow = _mm512_set1_epi32(0xFF);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m512i value = _mm512_cvtepu8_epi32(
+                _mm_loadu_si128((const __m128i*)(indata + i)));
+        storeAvx512(outdata + i, applyOverflowAvx512(value, overflow));
+    }
+    convertScalar(indata + i, outdata + i, size - i);
+}
+
+TARGET("avx512f")
+void convertAvx512(const uint16_t* indata, int outdata[], size_t size) {
+    const __m512i overflow = _mm512_set1_epi32(0xFFFF);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m512i value = _mm512_cvtepu16_epi32(
+                _mm256_loadu_si256((const __m256i*)(indata + i)));
+        storeAvx512(outdata + i, applyOverflowAvx512(value, overflow));
+    }
+    convertScalar(indata + i, outdata + i, size - i);
+}
+
+TARGET("avx512f")
+void convertAvx512(const uint32_t* indata, int outdata[], size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m512i value = _mm512_loadu_si512(indata + i);
+        value = _mm512_or_si512(value, _mm512_srai_epi32(value, 31));
+        storeAvx512(outdata + i, value);
+    }
+    convertScalar(indata + i, outdata + i, size - i);
+}
+
+#endif  // NEGGIA_X86_KERNELS
+
+SimdLevel detectSimdLevel() {
+#ifdef NEGGIA_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SimdLevel::SSE2;
+#endif
+    return SimdLevel::SCALAR;
+}
+
+template <class T>
+void convert(const T* indata, int outdata[], size_t size, SimdLevel level) {
+    switch (std::min(level, bestSimdLevel())) {
+#ifdef NEGGIA_X86_KERNELS
+        case SimdLevel::AVX512:
+            convertAvx512(indata, outdata, size);
+            return;
+        case SimdLevel::AVX2:
+            convertAvx2(indata, outdata, size);
+            return;
+        case SimdLevel::SSE2:
+            convertSse2(indata, outdata, size);
+            return;
+#endif
+        default:
+            convertScalar(indata, outdata, size);
+    }
+}
+
+}  // namespace
+
+SimdLevel bestSimdLevel() {
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+void transformToInt32(const uint8_t* indata,
+                      int outdata[],
+                      size_t size,
+                      SimdLevel level) {
+    convert(indata, outdata, size, level);
+}
+
+void transformToInt32(const uint16_t* indata,
+                      int outdata[],
+                      size_t size,
+                      SimdLevel level) {
+    convert(indata, outdata, size, level);
+}
+
+void transformToInt32(const uint32_t* indata,
+                      int outdata[],
+                      size_t size,
+                      SimdLevel level) {
+    convert(indata, outdata, size, level);
+}
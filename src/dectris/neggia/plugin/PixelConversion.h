@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef PIXELCONVERSION_H
+#define PIXELCONVERSION_H
+#include <cstddef>
+#include <cstdint>
+
+// Instruction sets of the conversion kernels, in increasing order.
+enum class SimdLevel { SCALAR, SSE2, AVX2, AVX512 };
+
+// best level supported by this build and the CPU it runs on
+SimdLevel bestSimdLevel();
+
+// Converts pixel values to the int32 values expected by XDS. The largest
+// value of the input type (overflow) is set to -1, values of uint32_t pixels
+// above INT32_MAX are set to -1 as well. Levels above bestSimdLevel() fall
+// back to the best supported level, all levels give identical results.
+void transformToInt32(const uint8_t* indata,
+                      int outdata[],
+                      size_t size,
+                      SimdLevel level = bestSimdLevel());
+void transformToInt32(const uint16_t* indata,
+                      int outdata[],
+                      size_t size,
+                      SimdLevel level = bestSimdLevel());
+void transformToInt32(const uint32_t* indata,
+                      int outdata[],
+                      size_t size,
+                      SimdLevel level = bestSimdLevel());
+
+#endif  // PIXELCONVERSION_H
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: MIT
+
+#include "PixelMask.h"
+#include <algorithm>
+
+namespace {
+// Spans only pay off if they are much smaller than the dense mask
+constexpr size_t MIN_PIXELS_PER_SPAN = 32;
+}  // namespace
+
+PixelMask::PixelMask(std::vector<int32_t> mask) {
+    for (size_t i = 0; i < mask.size(); ++i) {
+        if (!mask[i])
+            continue;
+        if (!_spans.empty()) {
+            Span& last = _spans.back();
+            if (last.value == mask[i] && last.start + last.length == i) {
+                ++last.length;
+                continue;
+            }
+        }
+        if (_spans.size() >= mask.size() / MIN_PIXELS_PER_SPAN) {
+            _spans.clear();
+            _dense = std::move(mask);
+            return;
+        }
+        _spans.push_back(Span{i, 1, mask[i]});
+    }
+}
+
+void PixelMask::apply(int data[], size_t first, size_t count) const {
+    if (!_dense.empty()) {
+        const int32_t* mask = _dense.data() + first;
+        for (size_t i = 0; i < count; ++i)
+            data[i] = mask[i] ? mask[i] : data[i];
+        return;
+    }
+    size_t end = first + count;
+    // first span which ends after pixel first
+    auto span = std::upper_bound(_spans.begin(), _spans.end(), first,
+                                 [](size_t pixel, const Span& s) {
+                                     return pixel < s.start + s.length;
+                                 });
+    for (; span != _spans.end() && span->start < end; ++span) {
+        size_t spanBegin = std::max(span->start, first);
+        size_t spanEnd = std::min(span->start + span->length, end);
+        std::fill(data + (spanBegin - first), data + (spanEnd - first),
+                  span->value);
+    }
+}
+
+bool PixelMask::isSparse() const {
+    return _dense.empty();
+}
@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef PIXELMASK_H
+#define PIXELMASK_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The masked pixels of a detector. Usually only a few percent of the pixels
+// are masked, mostly in module gaps, so the mask is stored as sorted runs of
+// pixels with the same mask value, frames are converted without a mask and
+// the masked pixels are set afterwards. Masks with too many runs are kept
+// as one value per pixel.
+class PixelMask {
+public:
+    PixelMask() = default;
+    // mask[i] is the value of pixel i, 0 for pixels which are not masked
+    explicit PixelMask(std::vector<int32_t> mask);
+
+    // sets the masked pixels in [first, first + count) in data, where data[0]
+    // is pixel first
+    void apply(int data[], size_t first, size_t count) const;
+    bool isSparse() const;
+
+private:
+    struct Span {
+        size_t start;
+        size_t length;
+        int32_t value;
+    };
+    std::vector<Span> _spans;
+    // empty if the mask is sparse
+    std::vector<int32_t> _dense;
+};
+
+#endif  // PIXELMASK_H
@@ -0,0 +1,304 @@
+// SPDX-License-Identifier: MIT
+
+#include "SidecarIndex.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr char MAGIC[8] = {'N', 'E', 'G', 'G', 'I', 'A', 'I', 'X'};
+// version 2 stores the compressed size of the frames
+constexpr uint32_t FORMAT_VERSION = 2;
+// detects indices written on a machine with different byte order
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr uint8_t RUN_LENGTH_MASK = 0;
+constexpr uint8_t DENSE_MASK = 1;
+// start, length and value of a run
+constexpr size_t BYTES_PER_RUN = 2 * sizeof(uint64_t) + sizeof(int32_t);
+
+struct FileStamp {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtimeSeconds;
+    int64_t mtimeNanoseconds;
+};
+
+bool getFileStamp(const std::string& path, FileStamp* stamp) {
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0)
+        return false;
+    stamp->device = status.st_dev;
+    stamp->inode = status.st_ino;
+    stamp->size = status.st_size;
+    stamp->mtimeSeconds = status.st_mtime;
+#ifdef __linux__
+    stamp->mtimeNanoseconds = status.st_mtim.tv_nsec;
+#else
+    stamp->mtimeNanoseconds = 0;
+#endif
+    return true;
+}
+
+bool operator==(const FileStamp& a, const FileStamp& b) {
+    return a.device == b.device && a.inode == b.inode && a.size == b.size &&
+           a.mtimeSeconds == b.mtimeSeconds &&
+           a.mtimeNanoseconds == b.mtimeNanoseconds;
+}
+
+bool getAbsolutePath(const std::string& path, std::string* absolutePath) {
+    char buffer[PATH_MAX];
+    if (!realpath(path.c_str(), buffer))
+        return false;
+    *absolutePath = buffer;
+    return true;
+}
+
+class Writer {
+public:
+    template <class T>
+    void write(const T& value) {
+        _data.append((const char*)&value, sizeof(T));
+    }
+    void write(const std::string& value) {
+        write((uint64_t)value.size());
+        _data.append(value);
+    }
+    void write(const FileStamp& stamp) {
+        write(stamp.device);
+        write(stamp.inode);
+        write(stamp.size);
+        write(stamp.mtimeSeconds);
+        write(stamp.mtimeNanoseconds);
+    }
+    const std::string& data() const { return _data; }
+
+private:
+    std::string _data;
+};
+
+class Reader {
+public:
+    explicit Reader(const std::string& data) : _data(data), _position(0) {}
+    template <class T>
+    T read() {
+        T value;
+        std::memcpy(&value, advance(sizeof(T)), sizeof(T));
+        return value;
+    }
+    std::string readString() {
+        uint64_t size = read<uint64_t>();
+        return std::string(advance(size), size);
+    }
+    FileStamp readFileStamp() {
+        FileStamp stamp;
+        stamp.device = read<uint64_t>();
+        stamp.inode = read<uint64_t>();
+        stamp.size = read<uint64_t>();
+        stamp.mtimeSeconds = read<int64_t>();
+        stamp.mtimeNanoseconds = read<int64_t>();
+        return stamp;
+    }
+    bool atEnd() const { return _position == _data.size(); }
+
+private:
+    const char* advance(size_t size) {
+        if (size > _data.size() - _position)
+            throw std::out_of_range("sidecar index is truncated");
+        const char* position = _data.data() + _position;
+        _position += size;
+        return position;
+    }
+
+    const std::string& _data;
+    size_t _position;
+};
+
+bool isUpToDate(const std::string& path, const FileStamp& stamp) {
+    FileStamp currentStamp;
+    return getFileStamp(path, &currentStamp) && currentStamp == stamp;
+}
+
+bool parseSidecarIndex(const std::string& data,
+                       const std::string& masterPath,
+                       SidecarIndex* index) {
+    Reader reader(data);
+    for (char c : MAGIC) {
+        if (reader.read<char>() != c)
+            return false;
+    }
+    if (reader.read<uint32_t>() != FORMAT_VERSION ||
+        reader.read<uint32_t>() != BYTE_ORDER_MARK)
+    {
+        return false;
+    }
+    if (!isUpToDate(masterPath, reader.readFileStamp()))
+        return false;
+    index->dimx = reader.read<int32_t>();
+    index->dimy = reader.read<int32_t>();
+    index->datasize = reader.read<int32_t>();
+    index->nframesPerDataset = reader.read<int32_t>();
+    index->masterFileOnly = reader.read<uint8_t>() != 0;
+    index->xpixelSize = reader.read<float>();
+    index->ypixelSize = reader.read<float>();
+
+    index->dataFiles.resize(reader.read<uint64_t>());
+    std::vector<uint64_t> dataFileSizes;
+    for (auto& dataFile : index->dataFiles) {
+        dataFile.path = reader.readString();
+        FileStamp stamp = reader.readFileStamp();
+        if (!isUpToDate(dataFile.path, stamp))
+            return false;
+        dataFile.objectHeaderAddress = reader.read<uint64_t>();
+        dataFileSizes.push_back(stamp.size);
+    }
+
+    index->frames.resize(reader.read<uint64_t>());
+    for (auto& frame : index->frames) {
+        frame.dataFile = reader.read<uint32_t>();
+        frame.offset = reader.read<uint64_t>();
+        frame.size = reader.read<uint64_t>();
+        // the size of a chunk is not always known exactly, only the start
+        // of the chunk can be checked
+        if (frame.dataFile >= index->dataFiles.size() ||
+            frame.offset >= dataFileSizes[frame.dataFile])
+        {
+            return false;
+        }
+    }
+
+    index->mask.assign((size_t)index->dimx * index->dimy, 0);
+    if (reader.read<uint8_t>() == DENSE_MASK) {
+        for (auto& value : index->mask)
+            value = reader.read<int32_t>();
+        return reader.atEnd();
+    }
+    uint64_t numberOfRuns = reader.read<uint64_t>();
+    for (uint64_t i = 0; i < numberOfRuns; ++i) {
+        uint64_t start = reader.read<uint64_t>();
+        uint64_t length = reader.read<uint64_t>();
+        int32_t value = reader.read<int32_t>();
+        if (start > index->mask.size() || length > index->mask.size() - start)
+            return false;
+        std::fill(index->mask.begin() + start,
+                  index->mask.begin() + start + length, value);
+    }
+    return reader.atEnd();
+}
+
+}  // namespace
+
+std::string sidecarIndexPath(const std::string& masterPath) {
+    return masterPath + ".neggia";
+}
+
+bool readSidecarIndex(const std::string& masterPath, SidecarIndex* index) {
+    std::ifstream file(sidecarIndexPath(masterPath), std::ios::binary);
+    if (!file)
+        return false;
+    std::string data((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+    try {
+        return parseSidecarIndex(data, masterPath, index);
+    } catch (const std::out_of_range&) {
+        return false;
+    }
+}
+
+bool writeSidecarIndex(const std::string& masterPath,
+                       const SidecarIndex& index) {
+    Writer writer;
+    for (char c : MAGIC)
+        writer.write(c);
+    writer.write(FORMAT_VERSION);
+    writer.write(BYTE_ORDER_MARK);
+    FileStamp stamp;
+    if (!getFileStamp(masterPath, &stamp))
+        return false;
+    writer.write(stamp);
+    writer.write(index.dimx);
+    writer.write(index.dimy);
+    writer.write(index.datasize);
+    writer.write(index.nframesPerDataset);
+    writer.write((uint8_t)index.masterFileOnly);
+    writer.write(index.xpixelSize);
+    writer.write(index.ypixelSize);
+
+    writer.write((uint64_t)index.dataFiles.size());
+    for (const auto& dataFile : index.dataFiles) {
+        std::string path;
+        if (!getAbsolutePath(dataFile.path, &path) ||
+            !getFileStamp(path, &stamp))
+        {
+            return false;
+        }
+        writer.write(path);
+        writer.write(stamp);
+        writer.write(dataFile.objectHeaderAddress);
+    }
+
+    writer.write((uint64_t)index.frames.size());
+    for (const auto& frame : index.frames) {
+        writer.write(frame.dataFile);
+        writer.write(frame.offset);
+        writer.write(frame.size);
+    }
+
+    // masks are usually stored as runs of equal non-zero values, masks with
+    // many short runs pixel by pixel
+    std::vector<size_t> runStarts;
+    for (size_t i = 0; i < index.mask.size(); ++i) {
+        if (index.mask[i] && (i == 0 || index.mask[i] != index.mask[i - 1]))
+            runStarts.push_back(i);
+    }
+    if (runStarts.size() * BYTES_PER_RUN > index.mask.size() * sizeof(int32_t))
+    {
+        writer.write(DENSE_MASK);
+        for (int32_t value : index.mask)
+            writer.write(value);
+    } else {
+        writer.write(RUN_LENGTH_MASK);
+        writer.write((uint64_t)runStarts.size());
+        for (size_t start : runStarts) {
+            size_t end = start + 1;
+            while (end < index.mask.size() &&
+                   index.mask[end] == index.mask[start])
+            {
+                ++end;
+            }
+            writer.write((uint64_t)start);
+            writer.write((uint64_t)(end - start));
+            writer.write(index.mask[start]);
+        }
+    }
+
+    // several processes may write the index at the same time, each of them
+    // replaces it with a complete file
+    std::stringstream temporaryPath;
+    temporaryPath << sidecarIndexPath(masterPath) << ".tmp" << getpid();
+    {
+        std::ofstream file(temporaryPath.str(), std::ios::binary);
+        file.write(writer.data().data(), writer.data().size());
+        if (!file.flush()) {
+            file.close();
+            std::remove(temporaryPath.str().c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporaryPath.str().c_str(),
+                    sidecarIndexPath(masterPath).c_str()) != 0)
+    {
+        std::remove(temporaryPath.str().c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef SIDECARINDEX_H
+#define SIDECARINDEX_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Header data and chunk locations of a master file, stored in a binary file
+// next to it, so that later processes do not have to parse the master file,
+// follow the links to the data files and preprocess the pixel mask again.
+struct SidecarIndex {
+    struct DataFile {
+        std::string path;
+        // of the dataset within the data file
+        uint64_t objectHeaderAddress;
+    };
+    struct Frame {
+        // index into dataFiles
+        uint32_t dataFile;
+        // location of the chunk, relative to the start of the data file
+        uint64_t offset;
+        // as returned by Dataset::chunkData()
+        uint64_t size;
+    };
+
+    int32_t dimx;
+    int32_t dimy;
+    int32_t datasize;
+    int32_t nframesPerDataset;
+    bool masterFileOnly;
+    float xpixelSize;
+    float ypixelSize;
+    std::vector<DataFile> dataFiles;
+    std::vector<Frame> frames;
+    // dimx * dimy mask values
+    std::vector<int32_t> mask;
+};
+
+std::string sidecarIndexPath(const std::string& masterPath);
+
+// Returns false if there is no index for masterPath, or if the master file or
+// one of the data files changed (modification time, size or inode) since the
+// index was written.
+bool readSidecarIndex(const std::string& masterPath, SidecarIndex* index);
+
+// Returns false if the index cannot be written. Paths of the data files are
+// stored as absolute paths.
+bool writeSidecarIndex(const std::string& masterPath,
+                       const SidecarIndex& index);
+
+#endif  // SIDECARINDEX_H
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: MIT
+
+#include <dectris/neggia/compression_algorithms/bitshuffle.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+const std::vector<size_t> ELEMENT_SIZES = {1, 2, 4, 8};
+// multiples of 8 elements, with and without remainders for the vector loops
+const std::vector<size_t> SIZES = {8, 16, 120, 128, 136, 1000, 4096, 4104};
+
+std::vector<char> randomData(size_t size, std::mt19937& rng) {
+    std::uniform_int_distribution<int> bytes(0, 255);
+    std::vector<char> data(size);
+    for (auto& byte : data)
+        byte = (char)bytes(rng);
+    return data;
+}
+
+}  // namespace
+
+TEST(TestBitshuffle, UntransposeMatchesScalar) {
+    std::mt19937 rng(42);
+    for (size_t elementSize : ELEMENT_SIZES) {
+        for (size_t size : SIZES) {
+            auto in = randomData(size * elementSize, rng);
+            std::vector<char> expected(in.size());
+            ASSERT_EQ(bshuf_untrans_bit_elem_scal(in.data(), expected.data(),
+                                                  size, elementSize),
+                      (int64_t)in.size());
+
+            std::vector<char> out(in.size());
+            ASSERT_EQ(bshuf_bitunshuffle(in.data(), out.data(), size,
+                                         elementSize, size),
+                      (int64_t)in.size());
+            ASSERT_EQ(out, expected) << "element size " << elementSize
+                                     << ", " << size << " elements";
+
+            if (!bshuf_using_AVX512())
+                continue;
+            std::vector<char> outAvx512(in.size());
+            ASSERT_EQ(bshuf_untrans_bit_elem_AVX512(in.data(),
+                                                    outAvx512.data(), size,
+                                                    elementSize),
+                      (int64_t)in.size());
+            ASSERT_EQ(outAvx512, expected) << "element size " << elementSize
+                                           << ", " << size << " elements";
+        }
+    }
+}
+
+TEST(TestBitshuffle, ShuffleAndUnshuffle) {
+    std::mt19937 rng(7);
+    for (size_t elementSize : ELEMENT_SIZES) {
+        size_t size = 4096 + 13;
+        auto in = randomData(size * elementSize, rng);
+        std::vector<char> shuffled(in.size());
+        std::vector<char> out(in.size());
+        ASSERT_EQ(bshuf_bitshuffle(in.data(), shuffled.data(), size,
+                                   elementSize, 0),
+                  (int64_t)in.size());
+        ASSERT_EQ(bshuf_bitunshuffle(shuffled.data(), out.data(), size,
+                                     elementSize, 0),
+                  (int64_t)in.size());
+        ASSERT_EQ(out, in);
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests
+TEST(TestBitshuffle, DISABLED_UntransposeThroughput) {
+    constexpr size_t BLOCK_BYTES = 8192;
+    constexpr size_t TOTAL_BYTES = 64 << 20;
+    std::mt19937 rng(1);
+    auto in = randomData(BLOCK_BYTES, rng);
+    std::vector<char> out(BLOCK_BYTES);
+    for (size_t elementSize : {1, 2, 4}) {
+        size_t size = BLOCK_BYTES / elementSize;
+        auto measure = [&](int64_t (*untranspose)(void*, void*, size_t,
+                                                  size_t)) {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t done = 0; done < TOTAL_BYTES; done += BLOCK_BYTES)
+                untranspose(in.data(), out.data(), size, elementSize);
+            std::chrono::duration<double> seconds =
+                    std::chrono::steady_clock::now() - start;
+            return TOTAL_BYTES / seconds.count() / 1e9;
+        };
+        std::cout << "element size " << elementSize << ": scalar "
+                  << measure(bshuf_untrans_bit_elem_scal) << " GB/s";
+        if (bshuf_using_AVX512()) {
+            std::cout << ", AVX-512 "
+                      << measure(bshuf_untrans_bit_elem_AVX512) << " GB/s";
+        }
+        std::cout << std::endl;
+    }
+}
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+
+#include <dectris/neggia/user/ChunkCache.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t CHUNK_SIZE = 64;
+
+ChunkCache::DecodeFunction fillWith(char value, std::atomic<int>& decodes) {
+    return [value, &decodes](char* data) {
+        ++decodes;
+        for (size_t i = 0; i < CHUNK_SIZE; ++i)
+            data[i] = value;
+    };
+}
+
+}  // namespace
+
+TEST(TestChunkCache, KeepsLeastRecentlyUsedChunksWithinBudget) {
+    std::atomic<int> decodes(0);
+    ChunkCache cache(3 * CHUNK_SIZE);
+    for (size_t key : {0, 1, 2, 0, 3}) {
+        auto chunk = cache.read(key, CHUNK_SIZE, fillWith(key, decodes));
+        ASSERT_EQ(chunk->size(), CHUNK_SIZE);
+        ASSERT_EQ((*chunk)[CHUNK_SIZE - 1], (char)key);
+    }
+    // chunk 1 was evicted when chunk 3 was read
+    ASSERT_EQ(decodes, 4);
+    ASSERT_EQ(cache.hits(), 1);
+    ASSERT_EQ(cache.misses(), 4);
+    for (size_t key : {0, 2, 3})
+        cache.read(key, CHUNK_SIZE, fillWith(key, decodes));
+    ASSERT_EQ(decodes, 4);
+    cache.read(1, CHUNK_SIZE, fillWith(1, decodes));
+    ASSERT_EQ(decodes, 5);
+    ASSERT_EQ(cache.hits(), 4);
+    ASSERT_EQ(cache.misses(), 5);
+}
+
+TEST(TestChunkCache, EvictsWhenBudgetShrinks) {
+    std::atomic<int> decodes(0);
+    ChunkCache cache(3 * CHUNK_SIZE);
+    for (size_t key : {0, 1, 2})
+        cache.read(key, CHUNK_SIZE, fillWith(key, decodes));
+    cache.setMaxBytes(CHUNK_SIZE);
+    ASSERT_EQ(cache.maxBytes(), CHUNK_SIZE);
+    cache.read(2, CHUNK_SIZE, fillWith(2, decodes));
+    ASSERT_EQ(decodes, 3);
+    cache.read(0, CHUNK_SIZE, fillWith(0, decodes));
+    ASSERT_EQ(decodes, 4);
+}
+
+TEST(TestChunkCache, DoesNotKeepChunksLargerThanBudget) {
+    std::atomic<int> decodes(0);
+    ChunkCache cache(CHUNK_SIZE / 2);
+    for (int i = 0; i < 2; ++i) {
+        auto chunk = cache.read(0, CHUNK_SIZE, fillWith(5, decodes));
+        ASSERT_EQ((*chunk)[0], 5);
+    }
+    ASSERT_EQ(decodes, 2);
+}
+
+TEST(TestChunkCache, DoesNotCacheErrors) {
+    std::atomic<int> decodes(0);
+    ChunkCache cache;
+    auto failingDecode = [&decodes](char*) {
+        ++decodes;
+        throw std::runtime_error("cannot decode chunk");
+    };
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_THROW(cache.read(0, CHUNK_SIZE, failingDecode),
+                     std::runtime_error);
+    }
+    ASSERT_EQ(decodes, 2);
+}
+
+TEST(TestChunkCache, DecodesChunkOnceForConcurrentReaders) {
+    std::atomic<int> decodes(0);
+    auto slowDecode = [&decodes](char* data) {
+        ++decodes;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        for (size_t i = 0; i < CHUNK_SIZE; ++i)
+            data[i] = 7;
+    };
+    ChunkCache cache;
+    std::vector<std::thread> threads;
+    std::atomic<int> failures(0);
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&]() {
+            auto chunk = cache.read(7, CHUNK_SIZE, slowDecode);
+            if ((*chunk)[1] != 7)
+                ++failures;
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    ASSERT_EQ(failures, 0);
+    ASSERT_EQ(decodes, 1);
+    ASSERT_EQ(cache.misses(), 1);
+    ASSERT_EQ(cache.hits(), 7);
+}
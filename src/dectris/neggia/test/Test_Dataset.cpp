@@ -1,7 +1,15 @@
 // SPDX-License-Identifier: MIT
 
+#include <dectris/neggia/data/H5ChunkRecord.h>
+#include <dectris/neggia/data/H5DataLayoutMsg.h>
+#include <dectris/neggia/data/H5Superblock.h>
 #include <dectris/neggia/user/Dataset.h>
 #include <dectris/neggia/user/H5File.h>
+#include <dectris/neggia/user/PathCatalog.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <numeric>
 #include "DatasetsFixture.h"
 
 TEST_F(TestDatasetArtificialSmall001, KeepsFileOpen) {
@@ -47,11 +55,57 @@ TEST_F(TestDatasetArtificialSmall001, MasterFile) {
     }
 }
 
+TEST_F(TestDatasetArtificialSmall001, View) {
+    Dataset pixelMask(H5File(getPathToSourceFile()),
+                      "/entry/instrument/detector/detectorSpecific/pixel_mask");
+    Dataset::ConstDataPointer view = pixelMask.view();
+    ASSERT_EQ(view.size, WIDTH * HEIGHT * sizeof(int));
+    ASSERT_EQ(memcmp(view.data, pixelMaskData, view.size), 0);
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    ASSERT_THROW(dataset.view(), std::runtime_error);
+}
+
+TEST_F(TestDatasetArtificialSmall001, RawChunk) {
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+        Dataset::RawChunk chunk = dataset.rawChunk({i, 0, 0});
+        Dataset::ConstDataPointer chunkData = dataset.chunkData({i, 0, 0});
+        ASSERT_EQ(chunk.data.data, chunkData.data);
+        ASSERT_EQ(chunk.data.size, chunkData.size);
+        ASSERT_EQ(chunk.filterMask, 0);
+        // the chunk decodes to the frame
+        DATA_TYPE dataArrayCompare[HEIGHT * WIDTH];
+        dataset.readChunk(chunk.data, dataArrayCompare);
+        ASSERT_EQ(memcmp(dataArrayCompare, dataArray, sizeof(dataArray)), 0);
+    }
+    ASSERT_THROW(dataset.rawChunk({N_FRAMES_PER_DATASET, 0, 0}),
+                 std::out_of_range);
+}
+
 TEST_F(TestDatasetArtificialSmall001, FollowLinkToGroup) {
     Dataset(H5File(getPathToSourceFile()),
             "/entry/link_to_detector_group/x_pixel_size");
 }
 
+TEST_F(TestDatasetArtificialSmall001, TryOpen) {
+    H5File file(getPathToSourceFile());
+    Dataset dataset;
+    ASSERT_TRUE(Dataset::tryOpen(
+            file, "/entry/link_to_detector_group/x_pixel_size", dataset));
+    float val;
+    dataset.read(&val);
+    ASSERT_EQ(val, X_PIXEL_SIZE);
+    // through the external link to the data file
+    ASSERT_TRUE(Dataset::tryOpen(file, getTargetDataset(0), dataset));
+    ASSERT_EQ(dataset.dim()[0], size_t(N_FRAMES_PER_DATASET));
+    ASSERT_FALSE(Dataset::tryOpen(file, "/entry/data/data_999999", dataset));
+    ASSERT_FALSE(Dataset::tryOpen(file, "/entry/missing/x", dataset));
+    ASSERT_FALSE(Dataset::tryOpen(
+            file, "/entry/instrument/detector/missing", dataset));
+    ASSERT_TRUE(file.exists(H5Path("/entry/instrument")));
+    ASSERT_FALSE(file.exists(H5Path("/entry/instrument/missing")));
+}
+
 TEST_F(TestDatasetArtificialSmall001, DataFile) {
     for (size_t datasetid = 0; datasetid < getNumberOfDatasets(); ++datasetid) {
         Dataset dataset(H5File(getPathToSourceFile()),
@@ -65,6 +119,160 @@ TEST_F(TestDatasetArtificialSmall001, DataFile) {
     }
 }
 
+TEST_F(TestDatasetArtificialSmall001, DataFileBlockwise) {
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+        DATA_TYPE dataArrayCompare[HEIGHT * WIDTH];
+        size_t nextElement = 0;
+        dataset.readChunkBlocks(
+                dataset.chunkData({i, 0, 0}),
+                [&](const void* block, size_t first, size_t count) {
+                    ASSERT_EQ(first, nextElement);
+                    ASSERT_EQ((uintptr_t)block % sizeof(DATA_TYPE), 0);
+                    memcpy(dataArrayCompare + first, block,
+                           count * sizeof(DATA_TYPE));
+                    nextElement += count;
+                });
+        ASSERT_EQ(nextElement, HEIGHT * WIDTH);
+        ASSERT_EQ(memcmp(dataArrayCompare, dataArray, sizeof(dataArray)), 0);
+    }
+}
+
+TEST_F(TestDatasetArtificialSmall001, DataFileOnThreadPool) {
+    ThreadPool threadPool(2);
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+        DATA_TYPE dataArrayCompare[HEIGHT * WIDTH];
+        dataset.read(dataArrayCompare, {i, 0, 0}, threadPool);
+        ASSERT_EQ(memcmp(dataArrayCompare, dataArray, sizeof(dataArray)), 0);
+
+        memset(dataArrayCompare, 0, sizeof(dataArrayCompare));
+        std::atomic<size_t> decodedElements(0);
+        dataset.readChunkBlocks(
+                dataset.chunkData({i, 0, 0}),
+                [&](const void* block, size_t first, size_t count) {
+                    memcpy(dataArrayCompare + first, block,
+                           count * sizeof(DATA_TYPE));
+                    decodedElements += count;
+                },
+                threadPool);
+        ASSERT_EQ(decodedElements, HEIGHT * WIDTH);
+        ASSERT_EQ(memcmp(dataArrayCompare, dataArray, sizeof(dataArray)), 0);
+    }
+}
+
+TEST_F(TestDatasetArtificialSmall001, ReadFrames) {
+    ThreadPool threadPool(2);
+    Dataset::ReadFramesOptions onThreadPool;
+    onThreadPool.threadPool = &threadPool;
+    for (const auto& options : {Dataset::ReadFramesOptions(), onThreadPool}) {
+        Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+        std::vector<DATA_TYPE> frames(N_FRAMES_PER_DATASET * HEIGHT * WIDTH);
+        dataset.readFrames(0, N_FRAMES_PER_DATASET, frames.data(), options);
+        for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+            ASSERT_EQ(memcmp(frames.data() + i * HEIGHT * WIDTH, dataArray,
+                             sizeof(dataArray)),
+                      0);
+        }
+        ASSERT_THROW(dataset.readFrames(1, N_FRAMES_PER_DATASET,
+                                        frames.data(), options),
+                     std::out_of_range);
+    }
+}
+
+TEST_F(TestDatasetArtificialSmall001, ReadRegion) {
+    ThreadPool threadPool(2);
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    size_t y0 = HEIGHT / 4, y1 = HEIGHT / 2, x0 = WIDTH / 3, x1 = WIDTH - 1;
+    std::vector<DATA_TYPE> region((y1 - y0) * (x1 - x0));
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+        for (bool onThreadPool : {false, true}) {
+            std::fill(region.begin(), region.end(), 0);
+            if (onThreadPool) {
+                dataset.readRegion(i, y0, y1, x0, x1, region.data(),
+                                   threadPool);
+            } else {
+                dataset.readRegion(i, y0, y1, x0, x1, region.data());
+            }
+            for (size_t y = y0; y < y1; ++y) {
+                ASSERT_EQ(memcmp(region.data() + (y - y0) * (x1 - x0),
+                                 dataArray + y * WIDTH + x0,
+                                 (x1 - x0) * sizeof(DATA_TYPE)),
+                          0);
+            }
+        }
+    }
+    ASSERT_THROW(dataset.readRegion(0, 0, HEIGHT + 1, 0, WIDTH, region.data()),
+                 std::out_of_range);
+}
+
+TEST_F(TestDatasetArtificialSmall001, ChunkIndex) {
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    Dataset copy(dataset);
+    copy.readChunkIndex();
+    size_t nframes = N_FRAMES_PER_DATASET;
+    auto chunks = dataset.chunkDataOfFrames(0, nframes);
+    ASSERT_EQ(chunks.size(), nframes);
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+        auto chunk = dataset.chunkData({i, 0, 0});
+        ASSERT_EQ(chunk.data, chunks[i].data);
+        ASSERT_EQ(chunk.size, chunks[i].size);
+        ASSERT_GT(chunk.size, 0u);
+    }
+    ASSERT_THROW(dataset.chunkData({N_FRAMES_PER_DATASET, 0, 0}),
+                 std::out_of_range);
+}
+
+TEST_F(TestDatasetArtificialSmall001, SharesMappingOfSameFile) {
+    H5File file(getPathToSourceFile());
+    H5File sameFile(getPathToSourceFile());
+    ASSERT_EQ(file.fileAddress(), sameFile.fileAddress());
+    ASSERT_EQ(H5File(file).fileAddress(), file.fileAddress());
+}
+
+TEST_F(TestDatasetArtificialSmall001, DataFileWithoutKeptMappings) {
+    size_t maxMappedFiles = H5File::maxMappedFiles();
+    H5File::setMaxMappedFiles(0);
+    for (size_t datasetid = 0; datasetid < getNumberOfDatasets(); ++datasetid) {
+        Dataset dataset(H5File(getPathToSourceFile()),
+                        getTargetDataset(datasetid));
+        Dataset reopenedDataset(H5File(dataset.h5File().path()),
+                                dataset.objectHeaderAddress());
+        DATA_TYPE dataArrayCompare[HEIGHT * WIDTH];
+        reopenedDataset.read(dataArrayCompare, {0, 0, 0});
+        ASSERT_EQ(memcmp(dataArrayCompare, dataArray, sizeof(dataArray)), 0);
+    }
+    H5File::setMaxMappedFiles(maxMappedFiles);
+}
+
+TEST_F(TestDatasetArtificialLarge001, RemembersResolvedPaths) {
+    H5File file(getPathToSourceFile());
+    H5Superblock superblock(file.fileAddress());
+    size_t hits = file.pathCatalog().hits();
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < getNumberOfDatasets(); ++i) {
+            auto resolvedPath = file.resolve(getTargetDataset(i));
+            auto expectedPath = superblock.resolve(getTargetDataset(i));
+            ASSERT_EQ(bool(resolvedPath.externalFile),
+                      bool(expectedPath.externalFile));
+            if (expectedPath.externalFile) {
+                ASSERT_EQ(resolvedPath.externalFile->filename,
+                          expectedPath.externalFile->filename);
+                ASSERT_EQ(std::string(resolvedPath.externalFile->h5Path),
+                          std::string(expectedPath.externalFile->h5Path));
+            } else {
+                ASSERT_EQ(resolvedPath.objectHeader.offset(),
+                          expectedPath.objectHeader.offset());
+            }
+        }
+    }
+    // shared by all H5File objects of the file
+    ASSERT_EQ(H5File(getPathToSourceFile()).pathCatalog().hits(),
+              hits + getNumberOfDatasets());
+    ASSERT_THROW(file.resolve(H5Path("/entry/data/data_999999")),
+                 std::out_of_range);
+}
+
 TEST_F(TestDatasetArtificialLarge001, LargeDataFile) {
     for (size_t datasetid = 0; datasetid < getNumberOfDatasets(); ++datasetid) {
         Dataset dataset(H5File(getPathToSourceFile()),
@@ -76,6 +284,196 @@ TEST_F(TestDatasetArtificialLarge001, LargeDataFile) {
     }
 }
 
+// The datasets in chunked-testfiles of frames chunked in other shapes than a
+// single frame hold the index of each element in C order
+const std::string CHUNKS_V110 = "chunked-testfiles/chunks_v110.h5";
+const std::string CHUNKS_EARLIEST = "chunked-testfiles/chunks_earliest.h5";
+const std::string MANY_CHUNKS_EARLIEST =
+        "chunked-testfiles/many_chunks_earliest.h5";
+
+H5DataLayoutMsg DataLayoutMsgOf(const H5File& h5File, const std::string& path) {
+    H5Superblock superblock(h5File.fileAddress());
+    auto resolvedPath = superblock.resolve(H5Path(path));
+    for (int i = 0, e = resolvedPath.objectHeader.numberOfMessages(); i < e;
+         ++i) {
+        auto msg = resolvedPath.objectHeader.headerMessage(i);
+        if (msg.type == H5DataLayoutMsg::TYPE_ID)
+            return H5DataLayoutMsg(msg.object);
+    }
+    throw std::out_of_range("no data layout message");
+}
+
+void CheckFramesOfChunks(const std::string& filename, const std::string& path) {
+    SCOPED_TRACE(filename + ":" + path);
+    Dataset dataset(H5File(filename), path);
+    std::vector<size_t> dim = dataset.dim();
+    std::vector<size_t> chunkShape = dataset.chunkShape();
+    ASSERT_EQ(dim.size(), 3u);
+    ASSERT_EQ(dataset.dataSize(), sizeof(uint32_t));
+    size_t frameSize = dim[1] * dim[2];
+    size_t chunksPerFrame = 1;
+    for (size_t i = 1; i < dim.size(); ++i)
+        chunksPerFrame *= (dim[i] + chunkShape[i] - 1) / chunkShape[i];
+    size_t numberOfChunks =
+            (dim[0] + chunkShape[0] - 1) / chunkShape[0] * chunksPerFrame;
+    std::vector<uint32_t> expected(dim[0] * frameSize);
+    std::iota(expected.begin(), expected.end(), 0);
+
+    std::vector<uint32_t> frames(dim[0] * frameSize);
+    dataset.readFrames(0, dim[0], frames.data());
+    ASSERT_TRUE(frames == expected);
+    ASSERT_EQ(dataset.chunkCache().misses(), numberOfChunks);
+    ASSERT_EQ(dataset.chunkCache().hits(), 0u);
+
+    // each frame is copied from the chunks decoded before
+    std::vector<uint32_t> frame(frameSize);
+    for (size_t i = 0; i < dim[0]; ++i) {
+        dataset.readFrames(i, 1, frame.data());
+        ASSERT_TRUE(std::equal(frame.begin(), frame.end(),
+                               expected.begin() + i * frameSize))
+                << "frame " << i;
+    }
+    ASSERT_EQ(dataset.chunkCache().misses(), numberOfChunks);
+    ASSERT_EQ(dataset.chunkCache().hits(), dim[0] * chunksPerFrame);
+
+    ThreadPool threadPool(2);
+    Dataset::ReadFramesOptions onThreadPool;
+    onThreadPool.threadPool = &threadPool;
+    Dataset reopenedDataset(H5File(filename), path);
+    std::fill(frames.begin(), frames.end(), 0);
+    reopenedDataset.readFrames(0, dim[0], frames.data(), onThreadPool);
+    ASSERT_TRUE(frames == expected);
+    ASSERT_EQ(reopenedDataset.chunkCache().misses(), numberOfChunks);
+}
+
+TEST(TestChunkShapes, FixedArray) {
+    CheckFramesOfChunks(CHUNKS_V110, "/fixed_array/frames");
+    CheckFramesOfChunks(CHUNKS_V110, "/fixed_array/tiles");
+    CheckFramesOfChunks(CHUNKS_V110, "/fixed_array/tiles_lz4");
+}
+
+TEST(TestChunkShapes, ExtensibleArray) {
+    CheckFramesOfChunks(CHUNKS_V110, "/extensible_array/frames");
+    CheckFramesOfChunks(CHUNKS_V110, "/extensible_array/tiles");
+}
+
+TEST(TestChunkShapes, BTreeVersion1) {
+    CheckFramesOfChunks(CHUNKS_EARLIEST, "/btree_v1/frames");
+    CheckFramesOfChunks(CHUNKS_EARLIEST, "/btree_v1/tiles");
+    CheckFramesOfChunks(CHUNKS_EARLIEST, "/btree_v1/tiles_lz4");
+}
+
+TEST(TestChunkShapes, BTreeVersion2) {
+    CheckFramesOfChunks(CHUNKS_V110, "/btree_v2/frames");
+    CheckFramesOfChunks(CHUNKS_V110, "/btree_v2/tiles");
+    CheckFramesOfChunks(CHUNKS_V110, "/btree_v2/tiles_lz4");
+}
+
+TEST(TestChunkShapes, ChunksOutsideOfArray) {
+    // 23 x 9 x 7 elements in chunks of 5 x 4 x 3
+    Dataset fixedArray(H5File(CHUNKS_V110), "/fixed_array/tiles");
+    ASSERT_GT(fixedArray.chunkData({20, 8, 6}).size, 0u);
+    ASSERT_THROW(fixedArray.chunkData({0, 12, 0}), std::out_of_range);
+    ASSERT_THROW(fixedArray.chunkData({25, 0, 0}), std::out_of_range);
+    ASSERT_THROW(fixedArray.chunkData({1000000, 0, 0}), std::out_of_range);
+    // 23 x 9 x 7 elements in chunks of 12 x 9 x 4
+    Dataset extensibleArray(H5File(CHUNKS_V110), "/extensible_array/tiles");
+    ASSERT_GT(extensibleArray.chunkData({12, 0, 4}).size, 0u);
+    ASSERT_THROW(extensibleArray.chunkData({0, 0, 8}), std::out_of_range);
+    ASSERT_THROW(extensibleArray.chunkData({24, 0, 0}), std::out_of_range);
+}
+
+TEST(TestBTreeVersion1, ReadsFramesAcrossLeaves) {
+    H5File h5File(MANY_CHUNKS_EARLIEST);
+    std::string path = "/btree_v1/many_chunks";
+    // 23 x 9 x 7 elements in chunks of 1 x 3 x 3, in several leaves below
+    // the root node
+    H5BLinkNode root(h5File.fileAddress(),
+                     DataLayoutMsgOf(h5File, path).read_u64(3));
+    ASSERT_EQ(root.nodeLevel(), 1);
+    ASSERT_GE(root.entriesUsed(), 3);
+
+    Dataset dataset(h5File, path);
+    std::vector<size_t> dim = dataset.dim();
+    size_t frameSize = dim[1] * dim[2];
+    std::vector<uint32_t> expected(dim[0] * frameSize);
+    std::iota(expected.begin(), expected.end(), 0);
+    std::vector<uint32_t> frames(dim[0] * frameSize);
+    size_t missingFrame = 11;
+    for (size_t numberOfFrames = 1; numberOfFrames <= 4; ++numberOfFrames) {
+        for (size_t first = 0; first + numberOfFrames <= dim[0]; ++first) {
+            if (first <= missingFrame && missingFrame < first + numberOfFrames)
+            {
+                ASSERT_THROW(dataset.readFrames(first, numberOfFrames,
+                                                frames.data()),
+                             std::out_of_range);
+                continue;
+            }
+            dataset.readFrames(first, numberOfFrames, frames.data());
+            ASSERT_TRUE(std::equal(frames.begin(),
+                                   frames.begin() + numberOfFrames * frameSize,
+                                   expected.begin() + first * frameSize))
+                    << "frames " << first << " to "
+                    << first + numberOfFrames;
+        }
+    }
+}
+
+TEST(TestBTreeVersion1, ChunkRecordsAcrossLeaves) {
+    H5File h5File(MANY_CHUNKS_EARLIEST);
+    std::string path = "/btree_v1/many_chunks";
+    H5DataLayoutMsg dataLayoutMsg = DataLayoutMsgOf(h5File, path);
+    Dataset dataset(h5File, path);
+    std::vector<size_t> dim = dataset.dim();
+    std::vector<size_t> chunkShape = dataset.chunkShape();
+    std::vector<size_t> missingChunk = {11, 3, 3};
+
+    // every chunk from the middle of the first leaf on, and one after the
+    // last chunk
+    std::vector<std::vector<size_t>> chunkOffsets;
+    for (size_t frame = 2; frame <= dim[0]; ++frame) {
+        for (size_t y = 0; y < dim[1]; y += chunkShape[1]) {
+            for (size_t x = 0; x < dim[2]; x += chunkShape[2])
+                chunkOffsets.push_back({frame, y, x});
+        }
+    }
+    auto records = dataLayoutMsg.getChunkRecords(dataset.dataSize(),
+                                                 chunkOffsets, dim);
+    ASSERT_EQ(records.size(), chunkOffsets.size());
+    for (size_t i = 0; i < chunkOffsets.size(); ++i) {
+        if (chunkOffsets[i] == missingChunk || chunkOffsets[i][0] == dim[0]) {
+            ASSERT_EQ(records[i].address,
+                      uint64_t(H5ChunkRecord::UNDEFINED_ADDRESS));
+            ASSERT_THROW(dataLayoutMsg.getChunkRecord(dataset.dataSize(),
+                                                      chunkOffsets[i], dim),
+                         std::out_of_range);
+            continue;
+        }
+        auto record = dataLayoutMsg.getChunkRecord(dataset.dataSize(),
+                                                   chunkOffsets[i], dim);
+        ASSERT_EQ(records[i].address, record.address);
+        ASSERT_EQ(records[i].size, record.size);
+    }
+    ASSERT_THROW(dataset.chunkData(missingChunk), std::out_of_range);
+    ASSERT_GT(dataset.chunkData({11, 0, 0}).size, 0u);
+    ASSERT_GT(dataset.chunkData({11, 6, 6}).size, 0u);
+}
+
+TEST(TestChunkRecord, KeepsSizeOfLargeChunks) {
+    // address, size in 8 bytes and filter mask of a filtered chunk
+    uint64_t address = 4096;
+    uint64_t size = (5ull << 30) + 3;
+    uint32_t filterMask = 1;
+    char entry[20];
+    memcpy(entry, &address, 8);
+    memcpy(entry + 8, &size, 8);
+    memcpy(entry + 16, &filterMask, 4);
+    H5ChunkRecord record = readFilteredChunkRecord(H5Object(entry, 0), 8);
+    ASSERT_EQ(record.address, address);
+    ASSERT_EQ(record.size, size);
+    ASSERT_EQ(record.filterMask, filterMask);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     ::testing::GTEST_FLAG(catch_exceptions) = false;
@@ -28,7 +28,14 @@ void CheckFrames(const std::string& filename,
     if (isChunked) {
         auto datasetArray =
                 std::unique_ptr<ValueType[]>(new ValueType[pixel_count]);
+        bool isCompressed = h5path.find("bslz4") != std::string::npos;
         for (size_t frame = 0; frame < nframes; ++frame) {
+            // frames of equal pixels compress well
+            size_t chunkSize = ds.chunkData({frame, 0, 0}).size;
+            if (isCompressed)
+                ASSERT_LT(chunkSize, pixel_count * sizeof(ValueType));
+            else
+                ASSERT_EQ(chunkSize, pixel_count * sizeof(ValueType));
             ds.read(datasetArray.get(), {frame, 0, 0});
             ValueType value = frame;
             for (size_t i = 0; i < pixel_count; ++i) {
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MIT
+
+#include <dectris/neggia/plugin/FrameCache.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+
+// Eviction and concurrent reads are tested with the ChunkCache in
+// Test_ChunkCache
+TEST(TestFrameCache, ReadsFramesThroughChunkCache) {
+    constexpr size_t frameSize = 16;
+    int reads = 0;
+    auto readFrame = [&reads](size_t frame, int* data) {
+        ++reads;
+        for (size_t i = 0; i < frameSize; ++i)
+            data[i] = (int)(frame * 1000 + i);
+    };
+    FrameCache cache(readFrame, frameSize, 3 * frameSize * sizeof(int));
+    ASSERT_EQ(cache.capacity(), 3u);
+    std::vector<int> data(frameSize);
+    for (size_t frame : {0, 1, 0, 1}) {
+        std::fill(data.begin(), data.end(), -1);
+        cache.read(frame, data.data());
+        for (size_t i = 0; i < frameSize; ++i)
+            ASSERT_EQ(data[i], (int)(frame * 1000 + i));
+    }
+    ASSERT_EQ(reads, 2);
+    ASSERT_EQ(cache.hits(), 2u);
+    ASSERT_EQ(cache.misses(), 2u);
+}
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MIT
+
+#include <dectris/neggia/user/Dataset.h>
+#include <dectris/neggia/user/Group.h>
+#include <dectris/neggia/user/H5File.h>
+#include <map>
+#include <set>
+#include "DatasetsFixture.h"
+
+namespace {
+void CheckDataLinks(const std::string& filename,
+                    const std::vector<std::string>& targetDatasets) {
+    H5File file(filename);
+    Group data(file, "/entry/data");
+    std::set<std::string> names;
+    data.forEachLink([&](const Group::Link& link) {
+        ASSERT_EQ(link.type, H5LinkMsg::EXTERNAL);
+        ASSERT_EQ(link.targetPath, "/entry/data/data");
+        names.insert("/entry/data/" + link.name);
+    });
+    ASSERT_EQ(names, std::set<std::string>(targetDatasets.begin(),
+                                           targetDatasets.end()));
+    ASSERT_EQ(data.links().size(), targetDatasets.size());
+}
+
+std::vector<std::string> targetDatasets(const TestDataset& test,
+                                        size_t numberOfDatasets) {
+    std::vector<std::string> result;
+    for (size_t i = 0; i < numberOfDatasets; ++i)
+        result.push_back(test.getTargetDataset(i));
+    return result;
+}
+}  // namespace
+
+TEST_F(TestDatasetArtificialSmall001, ListsDataLinks) {
+    CheckDataLinks(getPathToSourceFile(),
+                   targetDatasets(*this, getNumberOfDatasets()));
+}
+
+TEST_F(TestDatasetArtificialLarge001, ListsDataLinks) {
+    CheckDataLinks(getPathToSourceFile(),
+                   targetDatasets(*this, getNumberOfDatasets()));
+}
+
+TEST_F(TestDatasetArtificialSmall001, VisitsAllLinks) {
+    H5File file(getPathToSourceFile());
+    std::map<std::string, Group::Link> links;
+    Group(file, "/").visit([&](const std::string& path,
+                               const Group::Link& link) {
+        ASSERT_TRUE(links.insert({path, link}).second) << path;
+    });
+    ASSERT_EQ(links.at("entry").type, H5LinkMsg::HARD);
+    ASSERT_EQ(links.at("entry/data/data_000001").type, H5LinkMsg::EXTERNAL);
+    // the targets of hard links are the datasets opened by their paths
+    const auto& xPixelSize = links.at("entry/instrument/detector/x_pixel_size");
+    ASSERT_EQ(xPixelSize.type, H5LinkMsg::HARD);
+    Dataset dataset(file, xPixelSize.objectHeaderAddress);
+    float val;
+    dataset.read(&val);
+    ASSERT_EQ(val, X_PIXEL_SIZE);
+}
+
+TEST_F(TestDatasetArtificialSmall001, ThrowsIfNotAGroup) {
+    ASSERT_THROW(Group(H5File(getPathToSourceFile()), "/entry/missing"),
+                 std::out_of_range);
+    ASSERT_THROW(Group(H5File(getPathToSourceFile()), getTargetDataset(0)),
+                 std::runtime_error);
+}
+
+TEST(TestEarliest, ListsSymbolTable) {
+    H5File file("h5-testfiles/datasets_different_h5ver/dataset_earliest.h5");
+    std::map<std::string, Group::Link> links;
+    Group(file, "/data").forEachLink([&](const Group::Link& link) {
+        links[link.name] = link;
+    });
+    ASSERT_EQ(links.at("chunked").type, H5LinkMsg::HARD);
+    ASSERT_EQ(links.at("chunked_hard").type, H5LinkMsg::HARD);
+    ASSERT_EQ(links.at("chunked_hard").objectHeaderAddress,
+              links.at("chunked").objectHeaderAddress);
+    ASSERT_EQ(links.at("chunked_soft").type, H5LinkMsg::SOFT);
+    ASSERT_EQ(links.at("chunked_external").type, H5LinkMsg::EXTERNAL);
+    ASSERT_EQ(links.at("sub_hard").type, H5LinkMsg::HARD);
+    Dataset dataset(file, links.at("chunked").objectHeaderAddress);
+    ASSERT_TRUE(dataset.isChunked());
+}
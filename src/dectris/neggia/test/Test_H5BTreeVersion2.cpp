@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: MIT
+
+#include <dectris/neggia/data/H5BTreeVersion2.h>
+#include <dectris/neggia/data/H5DataLayoutMsg.h>
+#include <dectris/neggia/data/H5Superblock.h>
+#include <dectris/neggia/user/Dataset.h>
+#include <dectris/neggia/user/H5File.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+
+// Datasets of N x 1 x 1 elements of uint8 with the value of each element
+// i % 256, in chunks of a single element
+const std::string MANY_CHUNKS_V110 = "chunked-testfiles/many_chunks_v110.h5";
+
+H5BTreeVersion2 ChunkIndexOf(const H5File& h5File, const std::string& path) {
+    H5Superblock superblock(h5File.fileAddress());
+    auto resolvedPath = superblock.resolve(H5Path(path));
+    for (int i = 0, e = resolvedPath.objectHeader.numberOfMessages(); i < e;
+         ++i) {
+        auto msg = resolvedPath.objectHeader.headerMessage(i);
+        if (msg.type != H5DataLayoutMsg::TYPE_ID)
+            continue;
+        // see "Data Layout Message - Version 4": the address of the tree
+        // follows the dimensions of the chunks, the chunk indexing type,
+        // the node size and the split and merge percent
+        H5DataLayoutMsg dataLayoutMsg(msg.object);
+        size_t dimensionsSize =
+                dataLayoutMsg.read_u8(3) * dataLayoutMsg.read_u8(4);
+        return H5BTreeVersion2(h5File.fileAddress(),
+                               dataLayoutMsg.read_u64(12 + dimensionsSize));
+    }
+    throw std::out_of_range("no data layout message");
+}
+
+void CheckWalkFromEveryChunk(const std::string& path,
+                             unsigned int btreeType,
+                             unsigned int depth) {
+    SCOPED_TRACE(path);
+    H5File h5File(MANY_CHUNKS_V110);
+    H5BTreeVersion2 btree = ChunkIndexOf(h5File, path);
+    // type and depth in the header of the tree
+    ASSERT_EQ(btree.read_u8(5), btreeType);
+    ASSERT_EQ(btree.read_u16(12), depth);
+    size_t numberOfChunks = Dataset(h5File, path).dim()[0];
+    ASSERT_EQ(btree.getNumberOfRecords(), numberOfChunks);
+
+    std::vector<size_t> chunks;
+    btree.forEachChunkRecord(
+            {0, 0, 0}, 1,
+            [&](const uint64_t* chunkOffset, const H5ChunkRecord&) {
+                chunks.push_back(chunkOffset[0]);
+                return true;
+            });
+    ASSERT_EQ(chunks.size(), numberOfChunks);
+    for (size_t i = 0; i < numberOfChunks; ++i)
+        ASSERT_EQ(chunks[i], i);
+
+    // the walk starts in the middle of the tree and stops as soon as the
+    // callback returns false
+    const size_t maxChunks = 5;
+    for (size_t first = 0; first <= numberOfChunks; ++first) {
+        chunks.clear();
+        btree.forEachChunkRecord(
+                {first, 0, 0}, 1,
+                [&](const uint64_t* chunkOffset, const H5ChunkRecord& record) {
+                    H5ChunkRecord expected = btree.getChunkRecordByOffset(
+                            {chunkOffset[0], 0, 0}, 1);
+                    EXPECT_EQ(record.address, expected.address);
+                    EXPECT_EQ(record.size, expected.size);
+                    chunks.push_back(chunkOffset[0]);
+                    return chunks.size() < maxChunks;
+                });
+        ASSERT_EQ(chunks.size(), std::min(maxChunks, numberOfChunks - first))
+                << "first chunk " << first;
+        for (size_t i = 0; i < chunks.size(); ++i)
+            ASSERT_EQ(chunks[i], first + i);
+    }
+}
+
+TEST(TestH5BTreeVersion2, WalksChunksFromEveryChunk) {
+    CheckWalkFromEveryChunk("/btree_v2/many_chunks", 10, 2);
+}
+
+TEST(TestH5BTreeVersion2, WalksFilteredChunksFromEveryChunk) {
+    CheckWalkFromEveryChunk("/btree_v2/many_chunks_lz4", 11, 2);
+}
+
+TEST(TestH5BTreeVersion2, ReadsChunksOfFrames) {
+    H5File h5File(MANY_CHUNKS_V110);
+    for (std::string path :
+         {"/btree_v2/many_chunks", "/btree_v2/many_chunks_lz4"}) {
+        H5BTreeVersion2 btree = ChunkIndexOf(h5File, path);
+        size_t numberOfChunks = btree.getNumberOfRecords();
+        for (size_t first : {size_t(0), size_t(1000), numberOfChunks - 64}) {
+            auto records = btree.getChunkRecordsOfFrames(3, first, 64, 1);
+            ASSERT_EQ(records.size(), 64u);
+            for (size_t i = 0; i < records.size(); ++i) {
+                H5ChunkRecord expected =
+                        btree.getChunkRecordByOffset({first + i, 0, 0}, 1);
+                ASSERT_EQ(records[i].address, expected.address);
+            }
+        }
+        // chunks after the last one are not stored
+        auto records =
+                btree.getChunkRecordsOfFrames(3, numberOfChunks - 1, 2, 1);
+        ASSERT_NE(records[0].address,
+                  uint64_t(H5ChunkRecord::UNDEFINED_ADDRESS));
+        ASSERT_EQ(records[1].address,
+                  uint64_t(H5ChunkRecord::UNDEFINED_ADDRESS));
+
+        Dataset dataset(h5File, path);
+        std::vector<uint8_t> frames(numberOfChunks);
+        dataset.readFrames(0, numberOfChunks, frames.data());
+        for (size_t i = 0; i < numberOfChunks; ++i)
+            ASSERT_EQ(frames[i], uint8_t(i)) << path << " frame " << i;
+    }
+}
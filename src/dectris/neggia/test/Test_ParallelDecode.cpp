@@ -0,0 +1,326 @@
+// SPDX-License-Identifier: MIT
+
+#include <arpa/inet.h>
+#include <dectris/neggia/compression_algorithms/bitshuffle.h>
+#include <dectris/neggia/compression_algorithms/lz4.h>
+#include <dectris/neggia/data/Decode.h>
+#include <dectris/neggia/user/ThreadPool.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+const std::vector<size_t> ELEMENT_SIZES = {1, 2, 4};
+// with and without uncompressed elements at the end
+const std::vector<size_t> SIZES = {5, 4096, 100000, 100003};
+// 0 selects the default block size
+const std::vector<size_t> BLOCK_ELEMENTS = {0, 64};
+
+// small values, like the pixels of a diffraction image
+std::vector<char> randomData(size_t size, std::mt19937& rng) {
+    std::geometric_distribution<int> bytes(0.3);
+    std::vector<char> data(size);
+    for (auto& byte : data)
+        byte = (char)bytes(rng);
+    return data;
+}
+
+// Compresses data like the HDF5 bitshuffle filter: the size of the data and
+// the block size in bytes, followed by the compressed blocks.
+std::vector<char> compressBshufLz4(const std::vector<char>& data,
+                                   size_t elementSize,
+                                   size_t blockElements) {
+    size_t size = data.size() / elementSize;
+    std::vector<char> compressed(
+            12 + bshuf_compress_lz4_bound(size, elementSize, blockElements));
+    uint32_t header[3] = {0, htonl((uint32_t)data.size()),
+                          htonl((uint32_t)(blockElements * elementSize))};
+    memcpy(compressed.data(), header, sizeof(header));
+    int64_t compressedSize =
+            bshuf_compress_lz4(data.data(), compressed.data() + 12, size,
+                               elementSize, blockElements);
+    if (compressedSize < 0)
+        throw std::runtime_error("bshuf_compress_lz4 failed");
+    compressed.resize(12 + compressedSize);
+    return compressed;
+}
+
+// Compresses data like the HDF5 LZ4 filter: the size of the data and the
+// block size, followed by the blocks with their compressed size. Blocks which
+// do not get smaller are stored uncompressed.
+std::vector<char> compressLz4(const std::vector<char>& data,
+                              size_t blockSize) {
+    uint32_t header[3] = {0, htonl((uint32_t)data.size()),
+                          htonl((uint32_t)blockSize)};
+    std::vector<char> compressed((const char*)header,
+                                 (const char*)header + sizeof(header));
+    std::vector<char> block(
+            LZ4_compressBound((int)std::min(blockSize, data.size())));
+    for (size_t offset = 0; offset < data.size(); offset += blockSize) {
+        size_t size = std::min(blockSize, data.size() - offset);
+        int compressedSize =
+                LZ4_compress(data.data() + offset, block.data(), (int)size);
+        const char* blockData = block.data();
+        if (compressedSize <= 0 || (size_t)compressedSize >= size) {
+            compressedSize = (int)size;
+            blockData = data.data() + offset;
+        }
+        uint32_t blockHeader = htonl((uint32_t)compressedSize);
+        compressed.insert(compressed.end(), (const char*)&blockHeader,
+                          (const char*)&blockHeader + 4);
+        compressed.insert(compressed.end(), blockData,
+                          blockData + compressedSize);
+    }
+    return compressed;
+}
+
+ParallelFor parallelForOn(ThreadPool& threadPool) {
+    return [&threadPool](size_t numberOfTasks,
+                         const std::function<void(size_t)>& task) {
+        threadPool.parallelFor(numberOfTasks, task);
+    };
+}
+
+}  // namespace
+
+TEST(TestThreadPool, ParallelForRunsEveryTaskOnce) {
+    ThreadPool threadPool(3);
+    std::vector<std::atomic<int>> calls(1000);
+    for (auto& count : calls)
+        count = 0;
+    threadPool.parallelFor(calls.size(), [&](size_t i) { ++calls[i]; });
+    for (auto& count : calls)
+        ASSERT_EQ(count, 1);
+}
+
+TEST(TestThreadPool, ParallelForRethrowsException) {
+    ThreadPool threadPool(3);
+    ASSERT_THROW(threadPool.parallelFor(100,
+                                        [](size_t i) {
+                                            if (i == 17)
+                                                throw std::runtime_error("17");
+                                        }),
+                 std::runtime_error);
+    // the pool is still usable
+    std::atomic<size_t> calls(0);
+    threadPool.parallelFor(10, [&](size_t) { ++calls; });
+    ASSERT_EQ(calls, 10u);
+}
+
+TEST(TestThreadPool, ParallelForFromTask) {
+    ThreadPool threadPool(2);
+    std::atomic<size_t> calls(0);
+    threadPool.parallelFor(4, [&](size_t) {
+        threadPool.parallelFor(4, [&](size_t) { ++calls; });
+    });
+    ASSERT_EQ(calls, 16u);
+}
+
+TEST(TestParallelDecode, BshufLz4MatchesSerialDecode) {
+    std::mt19937 rng(3);
+    ThreadPool threadPool(3);
+    for (size_t elementSize : ELEMENT_SIZES) {
+        for (size_t size : SIZES) {
+            for (size_t blockElements : BLOCK_ELEMENTS) {
+                auto data = randomData(size * elementSize, rng);
+                auto compressed =
+                        compressBshufLz4(data, elementSize, blockElements);
+
+                std::vector<char> expected(data.size());
+                size_t expectedSize = expected.size();
+                bshufUncompressLz4(compressed.data(), expected.data(),
+                                   expectedSize, elementSize);
+                ASSERT_EQ(expected, data);
+
+                std::vector<char> out(data.size());
+                size_t outSize = out.size();
+                bshufUncompressLz4(compressed.data(), out.data(), outSize,
+                                   elementSize, parallelForOn(threadPool));
+                ASSERT_EQ(outSize, data.size());
+                ASSERT_EQ(out, data) << "element size " << elementSize << ", "
+                                     << size << " elements, block size "
+                                     << blockElements;
+            }
+        }
+    }
+}
+
+TEST(TestParallelDecode, BshufLz4BlocksCoverData) {
+    std::mt19937 rng(5);
+    ThreadPool threadPool(3);
+    for (size_t elementSize : ELEMENT_SIZES) {
+        for (size_t size : SIZES) {
+            auto data = randomData(size * elementSize, rng);
+            auto compressed = compressBshufLz4(data, elementSize, 64);
+            std::vector<char> out(data.size());
+            size_t outSize = out.size();
+            std::atomic<size_t> decodedBytes(0);
+            bshufUncompressLz4Blocks(
+                    compressed.data(), outSize, elementSize,
+                    [&](const char* block, size_t offset, size_t blockSize) {
+                        memcpy(out.data() + offset, block, blockSize);
+                        decodedBytes += blockSize;
+                    },
+                    parallelForOn(threadPool));
+            ASSERT_EQ(decodedBytes, data.size());
+            ASSERT_EQ(out, data) << "element size " << elementSize << ", "
+                                 << size << " elements";
+        }
+    }
+}
+
+TEST(TestParallelDecode, Lz4MatchesData) {
+    std::mt19937 rng(11);
+    ThreadPool threadPool(3);
+    for (size_t size : {5, 4096, 100000, 100003, 1000000}) {
+        // blocks of 5 bytes do not get smaller and are stored uncompressed
+        for (size_t blockSize : {64, 1000, 8192, 1 << 30}) {
+            auto data = randomData(size, rng);
+            auto compressed = compressLz4(data, blockSize);
+            std::vector<char> out(data.size());
+            size_t outSize = out.size();
+            lz4Decode(compressed.data(), out.data(), outSize,
+                      parallelForOn(threadPool));
+            ASSERT_EQ(outSize, data.size());
+            ASSERT_EQ(out, data)
+                    << size << " bytes, block size " << blockSize;
+
+            std::fill(out.begin(), out.end(), 0);
+            std::atomic<size_t> decodedBytes(0);
+            lz4DecodeBlocks(
+                    compressed.data(), outSize, 1,
+                    [&](const char* block, size_t offset, size_t blockSize) {
+                        memcpy(out.data() + offset, block, blockSize);
+                        decodedBytes += blockSize;
+                    },
+                    parallelForOn(threadPool));
+            ASSERT_EQ(decodedBytes, data.size());
+            ASSERT_EQ(out, data)
+                    << size << " bytes, block size " << blockSize;
+        }
+    }
+}
+
+TEST(TestParallelDecode, Lz4CorruptBlockThrows) {
+    std::mt19937 rng(13);
+    ThreadPool threadPool(3);
+    auto data = randomData(100000, rng);
+    auto compressed = compressLz4(data, 8192);
+    // wrong compressed size of the last block
+    size_t lastBlock = 12;
+    for (size_t offset = 0; offset + 8192 < data.size(); offset += 8192) {
+        uint32_t blockHeader;
+        memcpy(&blockHeader, compressed.data() + lastBlock, 4);
+        lastBlock += 4 + ntohl(blockHeader);
+    }
+    ASSERT_LE(lastBlock + 4, compressed.size());
+    uint32_t blockHeader;
+    memcpy(&blockHeader, compressed.data() + lastBlock, 4);
+    blockHeader = htonl(ntohl(blockHeader) - 1);
+    memcpy(compressed.data() + lastBlock, &blockHeader, 4);
+
+    std::vector<char> out(data.size());
+    size_t outSize = out.size();
+    ASSERT_THROW(lz4Decode(compressed.data(), out.data(), outSize),
+                 std::runtime_error);
+    ASSERT_THROW(lz4Decode(compressed.data(), out.data(), outSize,
+                           parallelForOn(threadPool)),
+                 std::runtime_error);
+}
+
+TEST(TestParallelDecode, Lz4ZeroBlockSizeThrows) {
+    ThreadPool threadPool(3);
+    // 100000 bytes in blocks of 0 bytes, the first block is stored
+    // uncompressed
+    std::vector<char> compressed(16, 0);
+    uint32_t size = htonl(100000);
+    memcpy(compressed.data() + 4, &size, 4);
+
+    std::vector<char> out(100000);
+    size_t outSize = out.size();
+    auto blockCallback = [](const char*, size_t, size_t) {};
+    ASSERT_THROW(lz4Decode(compressed.data(), out.data(), outSize),
+                 std::runtime_error);
+    ASSERT_THROW(
+            lz4DecodeBlocks(compressed.data(), outSize, 1, blockCallback),
+            std::runtime_error);
+    ASSERT_THROW(lz4Decode(compressed.data(), out.data(), outSize,
+                           parallelForOn(threadPool)),
+                 std::runtime_error);
+    ASSERT_THROW(lz4DecodeBlocks(compressed.data(), outSize, 1, blockCallback,
+                                 parallelForOn(threadPool)),
+                 std::runtime_error);
+}
+
+TEST(TestParallelDecode, Lz4EmptyData) {
+    ThreadPool threadPool(3);
+    // no blocks, the block size may be zero
+    std::vector<char> compressed(12, 0);
+    char out;
+    for (const ParallelFor& parallelFor :
+         {ParallelFor(), parallelForOn(threadPool)})
+    {
+        size_t outSize = 1;
+        lz4Decode(compressed.data(), &out, outSize, parallelFor);
+        ASSERT_EQ(outSize, 0);
+        outSize = 1;
+        lz4DecodeBlocks(
+                compressed.data(), outSize, 1,
+                [](const char*, size_t, size_t) {}, parallelFor);
+        ASSERT_EQ(outSize, 0);
+    }
+    size_t outSize = 1;
+    lz4Decode(compressed.data(), &out, outSize);
+    ASSERT_EQ(outSize, 0);
+    outSize = 1;
+    lz4DecodeBlocks(compressed.data(), outSize, 1,
+                    [](const char*, size_t, size_t) {});
+    ASSERT_EQ(outSize, 0);
+}
+
+TEST(TestParallelDecode, DecodesOnlyNeededBlocks) {
+    std::mt19937 rng(17);
+    ThreadPool threadPool(3);
+    size_t elementSize = 4;
+    auto data = randomData(100003 * elementSize, rng);
+    // bytes [begin, end) are needed
+    size_t begin = 50000 * elementSize;
+    size_t end = 50100 * elementSize;
+    auto isBlockNeeded = [&](size_t offset, size_t size) {
+        return offset < end && offset + size > begin;
+    };
+    for (bool bitshuffle : {true, false}) {
+        auto compressed = bitshuffle ? compressBshufLz4(data, elementSize, 64)
+                                     : compressLz4(data, 64 * elementSize);
+        for (const ParallelFor& parallelFor :
+             {ParallelFor(), parallelForOn(threadPool)})
+        {
+            std::vector<char> out(data.size());
+            size_t outSize = out.size();
+            std::atomic<size_t> decodedBytes(0);
+            auto blockCallback = [&](const char* block, size_t offset,
+                                     size_t blockSize) {
+                memcpy(out.data() + offset, block, blockSize);
+                decodedBytes += blockSize;
+            };
+            if (bitshuffle) {
+                bshufUncompressLz4Blocks(compressed.data(), outSize,
+                                         elementSize, isBlockNeeded,
+                                         blockCallback, parallelFor);
+            } else {
+                lz4DecodeBlocks(compressed.data(), outSize, elementSize,
+                                isBlockNeeded, blockCallback, parallelFor);
+            }
+            // the needed bytes span two blocks
+            ASSERT_EQ(decodedBytes, 2 * 64 * elementSize);
+            ASSERT_TRUE(std::equal(data.begin() + begin, data.begin() + end,
+                                   out.begin() + begin));
+        }
+    }
+}
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: MIT
+
+#include <dectris/neggia/plugin/PixelConversion.h>
+#include <dectris/neggia/plugin/PixelMask.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+const std::vector<SimdLevel> SIMD_LEVELS = {
+        SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2,
+        SimdLevel::AVX512};
+
+template <class T>
+std::vector<T> randomFrame(size_t size, std::mt19937& rng) {
+    // overflow values and (for uint32_t) values above INT32_MAX must be
+    // frequent enough to appear in every vector
+    std::uniform_int_distribution<uint32_t> values(
+            0, std::numeric_limits<T>::max());
+    std::uniform_int_distribution<int> special(0, 7);
+    std::vector<T> frame(size);
+    for (auto& value : frame) {
+        switch (special(rng)) {
+            case 0:
+                value = std::numeric_limits<T>::max();
+                break;
+            case 1:
+                value = 0;
+                break;
+            default:
+                value = (T)values(rng);
+        }
+    }
+    return frame;
+}
+
+std::vector<int32_t> randomMask(size_t size, std::mt19937& rng) {
+    // mostly unmasked pixels with a few runs of -1 and -2
+    std::uniform_int_distribution<int> maskValue(0, 19);
+    std::vector<int32_t> mask(size);
+    int32_t value = 0;
+    for (auto& m : mask) {
+        int r = maskValue(rng);
+        if (r < 3)
+            value = r == 0 ? -1 : r == 1 ? -2 : 0;
+        m = value;
+    }
+    return mask;
+}
+
+template <class T>
+void CheckAllSimdLevels() {
+    std::mt19937 rng(42);
+    // sizes which are not a multiple of the vector width, and an offset of
+    // one element for unaligned input and output
+    for (size_t size : {0, 1, 15, 17, 1030 * 3 + 7}) {
+        auto frame = randomFrame<T>(size + 1, rng);
+        std::vector<int> expected(size + 1);
+        transformToInt32(frame.data() + 1, expected.data() + 1, size,
+                         SimdLevel::SCALAR);
+        for (SimdLevel level : SIMD_LEVELS) {
+            if (level > bestSimdLevel())
+                continue;
+            std::vector<int> result(size + 1, 12345);
+            transformToInt32(frame.data() + 1, result.data() + 1, size, level);
+            ASSERT_EQ(result[0], 12345);
+            for (size_t i = 1; i <= size; ++i) {
+                ASSERT_EQ(result[i], expected[i])
+                        << "level " << (int)level << ", pixel " << i;
+            }
+        }
+    }
+}
+
+}  // namespace
+
+TEST(TestPixelConversion, ScalarReference) {
+    const uint8_t in8[] = {0, 1, 0xFE, 0xFF};
+    const uint16_t in16[] = {0, 1, 0xFFFE, 0xFFFF};
+    const uint32_t in32[] = {0, 1, 0x7FFFFFFF, 0x80000000};
+    int out[4];
+    transformToInt32(in8, out, 4, SimdLevel::SCALAR);
+    ASSERT_EQ(std::vector<int>(out, out + 4),
+              std::vector<int>({0, 1, 0xFE, -1}));
+    transformToInt32(in16, out, 4, SimdLevel::SCALAR);
+    ASSERT_EQ(std::vector<int>(out, out + 4),
+              std::vector<int>({0, 1, 0xFFFE, -1}));
+    transformToInt32(in32, out, 4, SimdLevel::SCALAR);
+    ASSERT_EQ(std::vector<int>(out, out + 4),
+              std::vector<int>({0, 1, 0x7FFFFFFF, -1}));
+}
+
+TEST(TestPixelConversion, Uint8MatchesScalar) {
+    CheckAllSimdLevels<uint8_t>();
+}
+
+TEST(TestPixelConversion, Uint16MatchesScalar) {
+    CheckAllSimdLevels<uint16_t>();
+}
+
+TEST(TestPixelConversion, Uint32MatchesScalar) {
+    CheckAllSimdLevels<uint32_t>();
+}
+
+void CheckPixelMask(const std::vector<int32_t>& dense, bool isSparse) {
+    PixelMask mask(dense);
+    ASSERT_EQ(mask.isSparse(), isSparse);
+    // apply in pieces of varying length, as for decoded blocks
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<size_t> pieceSize(0, 300);
+    std::vector<int> result(dense.size(), 1);
+    for (size_t first = 0; first < dense.size();) {
+        size_t count = std::min(pieceSize(rng), dense.size() - first);
+        mask.apply(result.data() + first, first, count);
+        first += count;
+    }
+    for (size_t i = 0; i < dense.size(); ++i)
+        ASSERT_EQ(result[i], dense[i] ? dense[i] : 1) << "pixel " << i;
+}
+
+TEST(TestPixelMask, SparseMatchesDenseMask) {
+    // module gaps: masked columns and rows
+    const size_t width = 1030, height = 514;
+    std::vector<int32_t> dense(width * height, 0);
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            if (x >= 512 && x < 518)
+                dense[y * width + x] = -1;
+            if (y == 255 || y == 256)
+                dense[y * width + x] = -2;
+        }
+    }
+    dense[1234] = -2;
+    CheckPixelMask(dense, true);
+}
+
+TEST(TestPixelMask, DenseMatchesDenseMask) {
+    std::mt19937 rng(7);
+    CheckPixelMask(randomMask(1030 * 7 + 3, rng), false);
+}
@@ -2,7 +2,12 @@
 
 #include <dectris/neggia/user/H5File.h>
 #include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include "DatasetsFixture.h"
 
@@ -28,6 +33,31 @@ typedef void (*plugin_get_data)(int* frame_number,
 
 typedef void (*plugin_close_file)(int* error_flag);
 
+typedef void (*plugin_open_file_handle)(const char*,
+                                        int* handle,
+                                        int info_array[1024],
+                                        int* error_flag);
+
+typedef void (*plugin_get_header_handle)(int* handle,
+                                         int* nx,
+                                         int* ny,
+                                         int* nbytes,
+                                         float* qx,
+                                         float* qy,
+                                         int* number_of_frames,
+                                         int info_array[1024],
+                                         int* error_flag);
+
+typedef void (*plugin_get_data_handle)(int* handle,
+                                       int* frame_number,
+                                       int* nx,
+                                       int* ny,
+                                       int data_array[],
+                                       int info_array[1024],
+                                       int* error_flag);
+
+typedef void (*plugin_close_file_handle)(int* handle, int* error_flag);
+
 class TestXdsPlugin : public TestDatasetArtificialSmall001 {
 public:
     void SetUp() {
@@ -38,6 +68,14 @@ public:
                 (plugin_get_header)dlsym(pluginHandle, "plugin_get_header");
         get_data = (plugin_get_data)dlsym(pluginHandle, "plugin_get_data");
         close_file = (plugin_close_file)dlsym(pluginHandle, "plugin_close");
+        open_file_handle = (plugin_open_file_handle)dlsym(pluginHandle,
+                                                          "plugin_open_handle");
+        get_header_handle = (plugin_get_header_handle)dlsym(
+                pluginHandle, "plugin_get_header_handle");
+        get_data_handle = (plugin_get_data_handle)dlsym(
+                pluginHandle, "plugin_get_data_handle");
+        close_file_handle = (plugin_close_file_handle)dlsym(
+                pluginHandle, "plugin_close_handle");
         error_flag = 1;
         memset(info_array, 0, sizeof(info_array));
     }
@@ -47,6 +85,10 @@ public:
     plugin_get_header get_header;
     plugin_get_data get_data;
     plugin_close_file close_file;
+    plugin_open_file_handle open_file_handle;
+    plugin_get_header_handle get_header_handle;
+    plugin_get_data_handle get_data_handle;
+    plugin_close_file_handle close_file_handle;
     int error_flag;
     int info_array[1024];
     constexpr static int DECTRIS_VENDOR = 1;
@@ -57,6 +99,14 @@ public:
 
 constexpr int TestXdsPlugin::DECTRIS_VENDOR;
 
+namespace {
+void copyFile(const std::string& source, const std::string& destination) {
+    std::ifstream in(source, std::ios::binary);
+    std::ofstream out(destination, std::ios::binary);
+    out << in.rdbuf();
+}
+}  // namespace
+
 TestXdsPlugin::PIXEL_MASK_CORRECTED_ARRAY
 TestXdsPlugin::applyPixelMaskCorrections(
         DATA_TYPE testDataArray[WIDTH * HEIGHT]) {
@@ -150,6 +200,164 @@ TEST_F(TestXdsPlugin, TestGetData) {
     close_file(&error_flag);
 }
 
+TEST_F(TestXdsPlugin, TestGetDataWithSidecarIndex) {
+    setenv("NEGGIA_INDEX", "1", 1);
+    std::string indexPath = getPathToSourceFile() + ".neggia";
+    std::remove(indexPath.c_str());
+    auto expectedArray = applyPixelMaskCorrections(this->dataArray);
+    // the first open writes the index, the second one reads it
+    for (int repetition = 0; repetition < 2; ++repetition) {
+        open_file(getPathToSourceFile().c_str(), info_array, &error_flag);
+        ASSERT_EQ(error_flag, 0);
+        int nx, ny, nbytes, number_of_frames;
+        float qx, qy;
+        get_header(&nx, &ny, &nbytes, &qx, &qy, &number_of_frames,
+                   info_array, &error_flag);
+        ASSERT_EQ(error_flag, 0);
+        ASSERT_EQ(nx, WIDTH);
+        ASSERT_EQ(ny, HEIGHT);
+        ASSERT_EQ(qx, X_PIXEL_SIZE);
+        ASSERT_EQ(qy, Y_PIXEL_SIZE);
+        ASSERT_EQ(number_of_frames,
+                  getNumberOfImages() * getNumberOfTriggers());
+        ASSERT_TRUE(std::ifstream(indexPath).good());
+
+        int dataArrayCompare[nx * ny];
+        for (int i = 0; i < number_of_frames; ++i) {
+            int frameNumber = i + 1;
+            get_data(&frameNumber, &nx, &ny, dataArrayCompare, info_array,
+                     &error_flag);
+            ASSERT_EQ(error_flag, 0);
+            for (size_t j = 0; j < WIDTH * HEIGHT; ++j) {
+                ASSERT_EQ(dataArrayCompare[j], expectedArray[j]);
+            }
+        }
+        close_file(&error_flag);
+        ASSERT_EQ(error_flag, 0);
+    }
+    std::remove(indexPath.c_str());
+    unsetenv("NEGGIA_INDEX");
+}
+
+TEST_F(TestXdsPlugin, TestGetDataOfFrameWrittenAfterGetHeader) {
+    // the second data file is written after plugin_get_header, as while XDS
+    // processes a data set which is still being collected
+    const std::string source = "h5-testfiles/dataset_artificial_large_001/";
+    const std::string directory = "frame_written_after_get_header/";
+    mkdir(directory.c_str(), 0755);
+    for (const char* name : {"test_master.h5", "test_data_000001.h5",
+                             "test_data_000003.h5"})
+    {
+        copyFile(source + name, directory + name);
+    }
+    std::remove((directory + "test_data_000002.h5").c_str());
+    open_file((directory + "test_master.h5").c_str(), info_array,
+              &error_flag);
+    ASSERT_EQ(error_flag, 0);
+    int nx, ny, nbytes, number_of_frames;
+    float qx, qy;
+    get_header(&nx, &ny, &nbytes, &qx, &qy, &number_of_frames, info_array,
+               &error_flag);
+    ASSERT_EQ(error_flag, 0);
+
+    int dataArrayCompare[WIDTH * HEIGHT];
+    auto expectedArray = applyPixelMaskCorrections(this->dataArray);
+    // frames of later data files are available although data_000002 is not
+    int frameNumber = 2 * N_FRAMES_PER_DATASET + 1;
+    get_data(&frameNumber, &nx, &ny, dataArrayCompare, info_array,
+             &error_flag);
+    ASSERT_EQ(error_flag, 0);
+    frameNumber = N_FRAMES_PER_DATASET + 1;
+    get_data(&frameNumber, &nx, &ny, dataArrayCompare, info_array,
+             &error_flag);
+    ASSERT_EQ(error_flag, -2);
+
+    copyFile(source + "test_data_000002.h5",
+             directory + "test_data_000002.h5");
+    for (int repetition = 0; repetition < 2; ++repetition) {
+        get_data(&frameNumber, &nx, &ny, dataArrayCompare, info_array,
+                 &error_flag);
+        ASSERT_EQ(error_flag, 0);
+        for (size_t i = 0; i < WIDTH * HEIGHT; ++i) {
+            ASSERT_EQ(dataArrayCompare[i], expectedArray[i]);
+        }
+    }
+    close_file(&error_flag);
+    ASSERT_EQ(error_flag, 0);
+    for (const char* name : {"test_master.h5", "test_data_000001.h5",
+                             "test_data_000002.h5", "test_data_000003.h5"})
+    {
+        std::remove((directory + name).c_str());
+    }
+    rmdir(directory.c_str());
+}
+
+TEST_F(TestXdsPlugin, TestCanOnlyOpenOneFileWithoutHandle) {
+    open_file(getPathToSourceFile().c_str(), info_array, &error_flag);
+    ASSERT_EQ(error_flag, 0);
+    open_file(getPathToSourceFile().c_str(), info_array, &error_flag);
+    ASSERT_EQ(error_flag, -4);
+    close_file(&error_flag);
+    ASSERT_EQ(error_flag, 0);
+    open_file(getPathToSourceFile().c_str(), info_array, &error_flag);
+    ASSERT_EQ(error_flag, 0);
+    close_file(&error_flag);
+}
+
+TEST_F(TestXdsPlugin, TestGetDataFromSeveralHandles) {
+    // a file opened without handle stays independent of the handles
+    open_file(getPathToSourceFile().c_str(), info_array, &error_flag);
+    ASSERT_EQ(error_flag, 0);
+    int handles[2];
+    for (auto& handle : handles) {
+        open_file_handle(getPathToSourceFile().c_str(), &handle, info_array,
+                         &error_flag);
+        ASSERT_EQ(error_flag, 0);
+        int nx, ny, nbytes, number_of_frames;
+        float qx, qy;
+        get_header_handle(&handle, &nx, &ny, &nbytes, &qx, &qy,
+                          &number_of_frames, info_array, &error_flag);
+        ASSERT_EQ(error_flag, 0);
+        ASSERT_EQ(nx, WIDTH);
+        ASSERT_EQ(ny, HEIGHT);
+        ASSERT_EQ(number_of_frames,
+                  getNumberOfImages() * getNumberOfTriggers());
+    }
+    ASSERT_NE(handles[0], handles[1]);
+
+    int nx = WIDTH;
+    int ny = HEIGHT;
+    int dataArrayCompare[WIDTH * HEIGHT];
+    auto expectedArray = applyPixelMaskCorrections(this->dataArray);
+    for (int i = 0; i < getNumberOfImages() * getNumberOfTriggers(); ++i) {
+        for (auto& handle : handles) {
+            int frameNumber = i + 1;
+            get_data_handle(&handle, &frameNumber, &nx, &ny, dataArrayCompare,
+                            info_array, &error_flag);
+            ASSERT_EQ(error_flag, 0);
+            for (size_t i = 0; i < WIDTH * HEIGHT; ++i) {
+                ASSERT_EQ(dataArrayCompare[i], expectedArray[i]);
+            }
+        }
+    }
+
+    close_file_handle(&handles[0], &error_flag);
+    ASSERT_EQ(error_flag, 0);
+    int frameNumber = 1;
+    get_data_handle(&handles[0], &frameNumber, &nx, &ny, dataArrayCompare,
+                    info_array, &error_flag);
+    ASSERT_EQ(error_flag, -2);
+    get_data_handle(&handles[1], &frameNumber, &nx, &ny, dataArrayCompare,
+                    info_array, &error_flag);
+    ASSERT_EQ(error_flag, 0);
+    close_file_handle(&handles[0], &error_flag);
+    ASSERT_EQ(error_flag, -2);
+    close_file_handle(&handles[1], &error_flag);
+    ASSERT_EQ(error_flag, 0);
+    close_file(&error_flag);
+    ASSERT_EQ(error_flag, 0);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     ::testing::GTEST_FLAG(catch_exceptions) = false;
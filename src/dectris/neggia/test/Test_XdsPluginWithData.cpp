@@ -3,8 +3,12 @@
 #include <dlfcn.h>
 #include <gtest/gtest.h>
 #include <array>
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <thread>
+#include <vector>
 
 typedef void (*plugin_open_file)(const char*,
                                  int info_array[1024],
@@ -28,6 +32,16 @@ typedef void (*plugin_get_data)(int* frame_number,
 
 typedef void (*plugin_close_file)(int* error_flag);
 
+uint64_t frameChecksum(const int* data, size_t size) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (uint32_t)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
 // We need to use a TestFixture here as each test has
 // to call dlclose() on TearDown.
 // Otherwise it will lead to errors in XdsPlugin
@@ -84,6 +98,62 @@ public:
             ASSERT_EQ(error_flag, 0);
         }
 
+        close_file(&error_flag);
+        ASSERT_EQ(error_flag, 0);
+    };
+    void CheckXdsPluginConcurrently(const std::string& filename,
+                                    int number_of_threads) {
+        constexpr int REPETITIONS = 4;
+        int error_flag;
+        int info_array[1024];
+
+        open_file(filename.c_str(), info_array, &error_flag);
+        ASSERT_EQ(error_flag, 0);
+
+        int nx, ny, nbytes, number_of_frames;
+        float qx, qy;
+        get_header(&nx, &ny, &nbytes, &qx, &qy, &number_of_frames, info_array,
+                   &error_flag);
+        ASSERT_EQ(error_flag, 0);
+
+        // Reference checksums from sequential reads
+        std::vector<uint64_t> checksums(number_of_frames);
+        auto dataArrayExtracted = std::unique_ptr<int[]>(new int[nx * ny]);
+        for (int i = 0; i < number_of_frames; ++i) {
+            int frameNumber = i + 1;
+            get_data(&frameNumber, &nx, &ny, dataArrayExtracted.get(),
+                     info_array, &error_flag);
+            ASSERT_EQ(error_flag, 0);
+            checksums[i] = frameChecksum(dataArrayExtracted.get(), nx * ny);
+        }
+
+        // Every thread reads all frames, starting at a different frame
+        std::atomic<int> failures(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < number_of_threads; ++t) {
+            threads.emplace_back([&, t]() {
+                int thread_info_array[1024];
+                int thread_error_flag;
+                int thread_nx = nx;
+                int thread_ny = ny;
+                auto data = std::unique_ptr<int[]>(new int[nx * ny]);
+                for (int n = 0; n < REPETITIONS * number_of_frames; ++n) {
+                    int i = (n + t) % number_of_frames;
+                    int frameNumber = i + 1;
+                    get_data(&frameNumber, &thread_nx, &thread_ny, data.get(),
+                             thread_info_array, &thread_error_flag);
+                    if (thread_error_flag != 0 ||
+                        frameChecksum(data.get(), nx * ny) != checksums[i])
+                    {
+                        ++failures;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        ASSERT_EQ(failures, 0);
+
         close_file(&error_flag);
         ASSERT_EQ(error_flag, 0);
     };
@@ -150,6 +220,71 @@ TEST_F(TestXdsPlugin, Eiger2With2DatafilesBSLZ4Uint32) {
             1028, 512, 7.5e-5, 7.5e-5, 4, 1);
 }
 
+TEST_F(TestXdsPlugin, Eiger1With2DatafilesLZ4Concurrent) {
+    CheckXdsPluginConcurrently(
+            "h5-testfiles/datasets_eiger1/"
+            "eiger1_testmode10_2datafiles_4images_lz4_master.h5",
+            8);
+}
+
+TEST_F(TestXdsPlugin, Eiger2With2DatafilesBSLZ4Concurrent) {
+    CheckXdsPluginConcurrently(
+            "h5-testfiles/datasets_eiger2/"
+            "eiger2_simread7_2datafiles_4images_bslz4_master.h5",
+            8);
+}
+
+TEST_F(TestXdsPlugin, Eiger2With2DatafilesBSLZ4Uint32Concurrent) {
+    CheckXdsPluginConcurrently(
+            "h5-testfiles/datasets_eiger2/"
+            "eiger2_simread7_2datafiles_4images_bslz4_uint32_master.h5",
+            8);
+}
+
+TEST_F(TestXdsPlugin, Eiger2With2DatafilesBSLZ4Prefetch) {
+    setenv("NEGGIA_PREFETCH", "2", 1);
+    setenv("NEGGIA_THREADS", "2", 1);
+    CheckXdsPlugin(
+            "h5-testfiles/datasets_eiger2/"
+            "eiger2_simread7_2datafiles_4images_bslz4_master.h5",
+            1028, 512, 7.5e-5, 7.5e-5, 4, 1);
+    CheckXdsPluginConcurrently(
+            "h5-testfiles/datasets_eiger2/"
+            "eiger2_simread7_2datafiles_4images_bslz4_master.h5",
+            8);
+    unsetenv("NEGGIA_PREFETCH");
+    unsetenv("NEGGIA_THREADS");
+}
+
+TEST_F(TestXdsPlugin, Eiger2With2DatafilesBSLZ4DecodeThreads) {
+    setenv("NEGGIA_DECODE_THREADS", "3", 1);
+    CheckXdsPlugin(
+            "h5-testfiles/datasets_eiger2/"
+            "eiger2_simread7_2datafiles_4images_bslz4_uint32_master.h5",
+            1028, 512, 7.5e-5, 7.5e-5, 4, 1);
+    CheckXdsPluginConcurrently(
+            "h5-testfiles/datasets_eiger2/"
+            "eiger2_simread7_2datafiles_4images_bslz4_master.h5",
+            8);
+    unsetenv("NEGGIA_DECODE_THREADS");
+}
+
+TEST_F(TestXdsPlugin, Eiger2With2DatafilesBSLZ4FrameCache) {
+    // room for two of the four frames
+    setenv("NEGGIA_CACHE_MB", "5", 1);
+    CheckXdsPluginConcurrently(
+            "h5-testfiles/datasets_eiger2/"
+            "eiger2_simread7_2datafiles_4images_bslz4_master.h5",
+            8);
+    setenv("NEGGIA_PREFETCH", "2", 1);
+    CheckXdsPluginConcurrently(
+            "h5-testfiles/datasets_eiger2/"
+            "eiger2_simread7_2datafiles_4images_bslz4_master.h5",
+            8);
+    unsetenv("NEGGIA_PREFETCH");
+    unsetenv("NEGGIA_CACHE_MB");
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     ::testing::GTEST_FLAG(catch_exceptions) = false;
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+
+# Creates the files in this directory, datasets whose chunks are not a single
+# frame, in each kind of chunk index:
+#
+#   chunks_v110.h5      fixed arrays, extensible arrays and version 2 B-trees
+#   chunks_earliest.h5  version 1 B-trees
+#   many_chunks_earliest.h5
+#                       a version 1 B-tree with several leaves
+#   many_chunks_v110.h5 version 2 B-trees of depth 2
+#
+# The elements of the datasets of shape (FRAMES, HEIGHT, WIDTH) are their
+# index in C order as uint32. The chunks are written with
+# write_direct_chunk(), so that chunks can be left out and filtered chunks
+# can be written without the LZ4 filter plugin.
+
+import argparse
+import h5py
+from h5py import h5d, h5p, h5s, h5t, h5z
+import itertools
+import numpy as np
+import os
+import struct
+
+FRAMES = 23
+HEIGHT = 9
+WIDTH = 7
+LZ4_FILTER = 32004
+
+
+def lz4(data):
+    """The chunk in the format of the LZ4 filter, a single block of literals"""
+    sequence = bytearray()
+    if len(data) < 15:
+        sequence.append(len(data) << 4)
+    else:
+        sequence.append(0xF0)
+        rest = len(data) - 15
+        while rest >= 255:
+            sequence.append(255)
+            rest -= 255
+        sequence.append(rest)
+    sequence += data
+    return (
+        struct.pack(">QI", len(data), len(data))
+        + struct.pack(">I", len(sequence))
+        + bytes(sequence)
+    )
+
+
+def create_dataset(
+    group, name, data, chunks, maxshape, compressed=False, missing_chunks=()
+):
+    dcpl = h5p.create(h5p.DATASET_CREATE)
+    dcpl.set_chunk(chunks)
+    # no modification times, so that the files only change with their content
+    dcpl.set_obj_track_times(False)
+    if compressed:
+        dcpl.set_filter(LZ4_FILTER, h5z.FLAG_OPTIONAL, (0,))
+    space = h5s.create_simple(
+        data.shape, tuple(h5s.UNLIMITED if m is None else m for m in maxshape)
+    )
+    dataset = h5d.create(
+        group.id, name.encode(), h5t.py_create(data.dtype), space, dcpl=dcpl
+    )
+    for offset in itertools.product(
+        *(range(0, n, c) for n, c in zip(data.shape, chunks))
+    ):
+        if offset in missing_chunks:
+            continue
+        # edge chunks are padded to the full chunk shape
+        chunk = np.zeros(chunks, data.dtype)
+        part = data[tuple(slice(o, o + c) for o, c in zip(offset, chunks))]
+        chunk[tuple(slice(0, n) for n in part.shape)] = part
+        payload = chunk.tobytes()
+        dataset.write_direct_chunk(offset, lz4(payload) if compressed else payload)
+
+
+def create_files(directory):
+    shape = (FRAMES, HEIGHT, WIDTH)
+    data = np.arange(FRAMES * HEIGHT * WIDTH, dtype=np.uint32).reshape(shape)
+    unlimited = (None, None, None)
+
+    with h5py.File(
+        os.path.join(directory, "chunks_v110.h5"), "w", libver=("v110", "v110")
+    ) as f:
+        group = f.create_group("fixed_array")
+        create_dataset(group, "frames", data, (10, HEIGHT, WIDTH), shape)
+        create_dataset(group, "tiles", data, (5, 4, 3), shape)
+        create_dataset(group, "tiles_lz4", data, (5, 4, 3), shape, True)
+        # only the elements in the index block of extensible arrays can be
+        # read, 4 chunks
+        group = f.create_group("extensible_array")
+        create_dataset(
+            group, "frames", data, (10, HEIGHT, WIDTH), (None, HEIGHT, WIDTH)
+        )
+        create_dataset(group, "tiles", data, (12, HEIGHT, 4), (None, HEIGHT, WIDTH))
+        group = f.create_group("btree_v2")
+        create_dataset(group, "frames", data, (10, HEIGHT, WIDTH), unlimited)
+        create_dataset(group, "tiles", data, (5, 4, 3), unlimited)
+        create_dataset(group, "tiles_lz4", data, (5, 4, 3), unlimited, True)
+
+    with h5py.File(
+        os.path.join(directory, "chunks_earliest.h5"), "w", libver="earliest"
+    ) as f:
+        group = f.create_group("btree_v1")
+        create_dataset(group, "frames", data, (10, HEIGHT, WIDTH), shape)
+        create_dataset(group, "tiles", data, (5, 4, 3), shape)
+        create_dataset(group, "tiles_lz4", data, (5, 4, 3), shape, True)
+
+    with h5py.File(
+        os.path.join(directory, "many_chunks_earliest.h5"), "w", libver="earliest"
+    ) as f:
+        group = f.create_group("btree_v1")
+        # 206 chunks in leaves of up to 64 chunks, below the root node
+        create_dataset(
+            group,
+            "many_chunks",
+            data,
+            (1, 3, 3),
+            shape,
+            missing_chunks=((11, 3, 3),),
+        )
+
+    with h5py.File(
+        os.path.join(directory, "many_chunks_v110.h5"),
+        "w",
+        libver=("v110", "v110"),
+    ) as f:
+        group = f.create_group("btree_v2")
+        # chunks of a single element, enough for trees of depth 2 in nodes of
+        # 2048 bytes
+        many = (np.arange(3200) % 256).astype(np.uint8).reshape(3200, 1, 1)
+        create_dataset(group, "many_chunks", many, (1, 1, 1), unlimited)
+        create_dataset(
+            group, "many_chunks_lz4", many[:2600], (1, 1, 1), unlimited, True
+        )
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument(
+        "directory",
+        nargs="?",
+        default=os.path.dirname(os.path.abspath(__file__)),
+    )
+    args = parser.parse_args()
+    create_files(args.directory)
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: MIT
+
+#include "ChunkCache.h"
+
+constexpr size_t ChunkCache::DEFAULT_MAX_BYTES;
+
+ChunkCache::ChunkCache(size_t maxBytes)
+      : _maxBytes(maxBytes), _bytes(0), _hits(0), _misses(0) {}
+
+size_t ChunkCache::maxBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _maxBytes;
+}
+
+void ChunkCache::setMaxBytes(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _maxBytes = maxBytes;
+    evict();
+}
+
+ChunkCache::ChunkData ChunkCache::read(size_t key,
+                                       size_t chunkSize,
+                                       const DecodeFunction& decode) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto entry = _entries.find(key);
+    while (entry != _entries.end() && !entry->second.data) {
+        _decoded.wait(lock);
+        entry = _entries.find(key);
+    }
+    if (entry != _entries.end()) {
+        ++_hits;
+        _leastRecentlyUsed.splice(_leastRecentlyUsed.end(), _leastRecentlyUsed,
+                                  entry->second.lruPosition);
+        return entry->second.data;
+    }
+
+    ++_misses;
+    auto lruPosition = _leastRecentlyUsed.insert(_leastRecentlyUsed.end(), key);
+    _entries[key] = Entry{nullptr, lruPosition};
+    lock.unlock();
+    std::shared_ptr<std::vector<char>> chunkData;
+    try {
+        chunkData.reset(new std::vector<char>(chunkSize));
+        decode(chunkData->data());
+    } catch (...) {
+        lock.lock();
+        _leastRecentlyUsed.erase(lruPosition);
+        _entries.erase(key);
+        _decoded.notify_all();
+        throw;
+    }
+    lock.lock();
+    if (chunkSize > _maxBytes) {
+        _leastRecentlyUsed.erase(lruPosition);
+        _entries.erase(key);
+    } else {
+        _entries[key].data = chunkData;
+        _bytes += chunkSize;
+        evict();
+    }
+    _decoded.notify_all();
+    return chunkData;
+}
+
+size_t ChunkCache::hits() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _hits;
+}
+
+size_t ChunkCache::misses() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _misses;
+}
+
+void ChunkCache::evict() {
+    auto key = _leastRecentlyUsed.begin();
+    while (_bytes > _maxBytes && key != _leastRecentlyUsed.end()) {
+        auto entry = _entries.find(*key);
+        if (!entry->second.data) {
+            // still being decoded
+            ++key;
+            continue;
+        }
+        _bytes -= entry->second.data->size();
+        _entries.erase(entry);
+        key = _leastRecentlyUsed.erase(key);
+    }
+}
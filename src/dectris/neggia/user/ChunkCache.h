@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef CHUNKCACHE_H
+#define CHUNKCACHE_H
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Keeps the most recently decoded chunks of a dataset up to a memory budget,
+// so that chunks holding several frames or parts of several frames are not
+// decoded again for each frame. Threads which request a chunk that is being
+// decoded by another thread wait for that decode instead of decoding the
+// chunk again.
+class ChunkCache {
+public:
+    typedef std::shared_ptr<const std::vector<char>> ChunkData;
+    // writes the decoded chunk to the given buffer of the chunk size
+    typedef std::function<void(char*)> DecodeFunction;
+
+    constexpr static size_t DEFAULT_MAX_BYTES = 64 << 20;
+
+    explicit ChunkCache(size_t maxBytes = DEFAULT_MAX_BYTES);
+
+    size_t maxBytes() const;
+    // Evicts chunks until the cached chunks fit into maxBytes
+    void setMaxBytes(size_t maxBytes);
+    // May be called concurrently. The chunk with the given key (e.g. its
+    // address in the file) is decoded with decode if it is not cached.
+    // Chunks larger than the budget are returned but not kept. Exceptions of
+    // decode are rethrown and the chunk is not cached.
+    ChunkData read(size_t key, size_t chunkSize, const DecodeFunction& decode);
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    struct Entry {
+        // nullptr while the chunk is decoded
+        ChunkData data;
+        // position in _leastRecentlyUsed
+        std::list<size_t>::iterator lruPosition;
+    };
+
+    void evict();
+
+    size_t _maxBytes;
+    // of the decoded chunks in _entries
+    size_t _bytes;
+    mutable std::mutex _mutex;
+    std::condition_variable _decoded;
+    std::unordered_map<size_t, Entry> _entries;
+    // keys, least recently used first
+    std::list<size_t> _leastRecentlyUsed;
+    size_t _hits;
+    size_t _misses;
+};
+
+#endif  // CHUNKCACHE_H
@@ -11,42 +11,107 @@
 #include <dectris/neggia/data/H5LinkInfoMessage.h>
 #include <dectris/neggia/data/H5LinkMsg.h>
 #include <dectris/neggia/data/H5LocalHeap.h>
-#include <dectris/neggia/data/H5Superblock.h>
 #include <dectris/neggia/data/constants.h>
 #include <string.h>
+#include <algorithm>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 
+struct Dataset::ChunkIndex {
+    std::once_flag read;
+    // indexed by frame
+    std::vector<H5DataLayoutMsg::ChunkRecord> chunks;
+};
+
 Dataset::Dataset()
-      : _filterId(-1), _dataSize(0), _dataTypeId(-1), _isSigned(false) {}
+      : _filterId(-1),
+        _dataSize(0),
+        _dataTypeId(-1),
+        _isSigned(false),
+        _chunkIndex(std::make_shared<ChunkIndex>()),
+        _chunkCache(std::make_shared<ChunkCache>()) {}
 
 Dataset::Dataset(const H5File& h5File, const std::string& path)
       : _h5File(h5File),
         _filterId(-1),
         _dataSize(0),
         _dataTypeId(-1),
-        _isSigned(false) {
-    H5Superblock root(_h5File.fileAddress());
+        _isSigned(false),
+        _chunkIndex(std::make_shared<ChunkIndex>()),
+        _chunkCache(std::make_shared<ChunkCache>()) {
+    bool found;
     try {
-        auto resolvedPath = root.resolve(path);
-        while (resolvedPath.externalFile) {
-            auto targetFile = resolvedPath.externalFile->filename;
-            if (targetFile[0] != '/')
-                targetFile = _h5File.fileDir() + "/" + targetFile;
-            _h5File = H5File(targetFile);
-            root = H5Superblock(_h5File.fileAddress());
-            resolvedPath = root.resolve(resolvedPath.externalFile->h5Path);
-        }
-        _dataSymbolObjectHeader = resolvedPath.objectHeader;
+        found = resolvePath(path);
     } catch (std::exception& exc) {
         std::cerr << "exception during path resolve: " << exc.what() << "\n";
         throw std::out_of_range(exc.what());
     }
+    if (!found) {
+        std::cerr << "exception during path resolve: could not find " << path
+                  << "\n";
+        throw std::out_of_range("could not find " + path);
+    }
+    parseDataSymbolTable();
+}
+
+Dataset::Dataset(const H5File& h5File, size_t objectHeaderAddress)
+      : _h5File(h5File),
+        _dataSymbolObjectHeader(h5File.fileAddress(), objectHeaderAddress),
+        _filterId(-1),
+        _dataSize(0),
+        _dataTypeId(-1),
+        _isSigned(false),
+        _chunkIndex(std::make_shared<ChunkIndex>()),
+        _chunkCache(std::make_shared<ChunkCache>()) {
     parseDataSymbolTable();
 }
 
 Dataset::~Dataset() {}
 
+bool Dataset::tryOpen(const H5File& h5File,
+                      const std::string& path,
+                      Dataset& dataset) {
+    Dataset result;
+    result._h5File = h5File;
+    bool found;
+    try {
+        found = result.resolvePath(path);
+    } catch (std::exception& exc) {
+        throw std::out_of_range(exc.what());
+    }
+    if (!found)
+        return false;
+    result.parseDataSymbolTable();
+    dataset = result;
+    return true;
+}
+
+bool Dataset::resolvePath(const std::string& path) {
+    ResolvedPath resolvedPath;
+    if (!_h5File.tryResolve(path, resolvedPath))
+        return false;
+    while (resolvedPath.externalFile) {
+        auto targetFile = resolvedPath.externalFile->filename;
+        if (targetFile[0] != '/')
+            targetFile = _h5File.fileDir() + "/" + targetFile;
+        H5Path targetPath = resolvedPath.externalFile->h5Path;
+        _h5File = H5File(targetFile);
+        if (!_h5File.tryResolve(targetPath, resolvedPath))
+            return false;
+    }
+    _dataSymbolObjectHeader = resolvedPath.objectHeader;
+    return true;
+}
+
+const H5File& Dataset::h5File() const {
+    return _h5File;
+}
+
+size_t Dataset::objectHeaderAddress() const {
+    return _dataSymbolObjectHeader.offset();
+}
+
 unsigned int Dataset::dataTypeId() const {
     return (unsigned int)_dataTypeId;
 }
@@ -71,6 +136,79 @@ std::vector<size_t> Dataset::chunkShape() const {
     return _dataLayoutMsg.chunkShape();
 }
 
+void Dataset::readChunkBlocks(ConstDataPointer rawData,
+                              const BlockCallback& blockCallback) const {
+    readChunkBlocks(rawData, blockCallback, ParallelFor());
+}
+
+void Dataset::readChunkBlocks(ConstDataPointer rawData,
+                              const BlockCallback& blockCallback,
+                              ThreadPool& threadPool) const {
+    readChunkBlocks(rawData, blockCallback,
+                    [&threadPool](size_t numberOfTasks,
+                                  const std::function<void(size_t)>& task) {
+                        threadPool.parallelFor(numberOfTasks, task);
+                    });
+}
+
+void Dataset::readChunkBlocks(ConstDataPointer rawData,
+                              const BlockCallback& blockCallback,
+                              const ParallelFor& parallelFor) const {
+    size_t s = chunkDataSize();
+    size_t elementSize = _dataSize;
+    // Uncompressed pieces point into the file and may be unaligned, these
+    // are copied in small pieces to aligned memory. Pieces may be decoded
+    // concurrently, so each call has its own buffer.
+    auto decodedBlock = [&](const char* data, size_t offset, size_t size) {
+        if ((uintptr_t)data % elementSize == 0) {
+            blockCallback(data, offset / elementSize, size / elementSize);
+            return;
+        }
+        constexpr size_t ALIGNED_BUFFER_SIZE = 8192;
+        uint64_t alignedBuffer[ALIGNED_BUFFER_SIZE / sizeof(uint64_t)];
+        size_t piece = ALIGNED_BUFFER_SIZE - ALIGNED_BUFFER_SIZE % elementSize;
+        for (size_t i = 0; i < size; i += piece) {
+            size_t n = std::min(piece, size - i);
+            memcpy(alignedBuffer, data + i, n);
+            blockCallback(alignedBuffer, (offset + i) / elementSize,
+                          n / elementSize);
+        }
+    };
+    switch (_filterId) {
+        case -1:
+            if (s != rawData.size) {
+                throw std::runtime_error(
+                        "cannot read " + std::to_string(s) +
+                        " bytes from a dataset of size " +
+                        std::to_string(rawData.size));
+            }
+            decodedBlock(rawData.data, 0, s);
+            break;
+        case LZ4_FILTER:
+            if (parallelFor) {
+                lz4DecodeBlocks(rawData.data, s, elementSize, decodedBlock,
+                                parallelFor);
+            } else {
+                lz4DecodeBlocks(rawData.data, s, elementSize, decodedBlock);
+            }
+            break;
+        case BSHUF_H5FILTER:
+            assert(_filterCdValues.size() > 4);
+            assert(_filterCdValues[4] == BSHUF_H5_COMPRESS_LZ4);
+            if (parallelFor) {
+                bshufUncompressLz4Blocks(rawData.data, s, _filterCdValues[2],
+                                         decodedBlock, parallelFor);
+            } else {
+                bshufUncompressLz4Blocks(rawData.data, s, _filterCdValues[2],
+                                         decodedBlock);
+            }
+            break;
+        default:
+            throw std::runtime_error("filter " + std::to_string(_filterId) +
+                                     " not supported.");
+    }
+}
+
 void Dataset::readRawData(ConstDataPointer rawData,
                           void* outData,
                           size_t outDataSize) const {
@@ -84,42 +222,427 @@ void Dataset::readRawData(ConstDataPointer rawData,
 
 void Dataset::readLz4Data(Dataset::ConstDataPointer rawData,
                           void* data,
-                          size_t s) const {
-    lz4Decode(rawData.data, (char*)data, s);
+                          size_t s,
+                          const ParallelFor& parallelFor) const {
+    if (parallelFor) {
+        lz4Decode(rawData.data, (char*)data, s, parallelFor);
+    } else {
+        lz4Decode(rawData.data, (char*)data, s);
+    }
 }
 
 void Dataset::readBitshuffleData(ConstDataPointer rawData,
                                  void* data,
-                                 size_t s) const {
+                                 size_t s,
+                                 const ParallelFor& parallelFor) const {
     assert(_filterCdValues.size() > 4);
     assert(_filterCdValues[4] == BSHUF_H5_COMPRESS_LZ4);
     int elementSize = _filterCdValues[2];
-    bshufUncompressLz4(rawData.data, (char*)data, s, elementSize);
+    if (parallelFor) {
+        bshufUncompressLz4(rawData.data, (char*)data, s, elementSize,
+                           parallelFor);
+    } else {
+        bshufUncompressLz4(rawData.data, (char*)data, s, elementSize);
+    }
 }
 
 size_t Dataset::chunkDataSize() const {
     size_t s = _dataSize;
-    if (isChunked()) {
-        assert(chunkShape() == std::vector<size_t>({1, _dim[1], _dim[2]}));
-        return _dataSize * _dim[1] * _dim[2];
-    }
-    for (auto d : _dim)
+    for (auto d : isChunked() ? chunkShape() : _dim)
         s *= d;
     return s;
 }
 
 void Dataset::read(void* data, const std::vector<size_t>& chunkOffset) const {
-    auto rawData = _dataLayoutMsg.getRawData(_dataSize, chunkOffset);
+    readChunk(chunkData(chunkOffset), data);
+}
+
+void Dataset::read(void* data,
+                   const std::vector<size_t>& chunkOffset,
+                   ThreadPool& threadPool) const {
+    readChunk(chunkData(chunkOffset), data, threadPool);
+}
+
+Dataset::ConstDataPointer Dataset::chunkData(
+        const std::vector<size_t>& chunkOffset) const {
+    if (!isChunked())
+        return _dataLayoutMsg.getRawData(_dataSize, chunkOffset, _maxDim);
+    H5DataLayoutMsg::ChunkRecord chunk = chunkRecord(chunkOffset);
+    return ConstDataPointer{_h5File.fileAddress() + chunk.address, chunk.size};
+}
+
+Dataset::RawChunk Dataset::rawChunk(
+        const std::vector<size_t>& chunkOffset) const {
+    if (!isChunked())
+        return RawChunk{chunkData(), _filterId, _filterCdValues, 0};
+    H5DataLayoutMsg::ChunkRecord chunk = chunkRecord(chunkOffset);
+    return RawChunk{
+            ConstDataPointer{_h5File.fileAddress() + chunk.address, chunk.size},
+            _filterId, _filterCdValues, chunk.filterMask};
+}
+
+Dataset::ConstDataPointer Dataset::view() const {
+    if (isChunked())
+        throw std::runtime_error("dataset is chunked");
+    ConstDataPointer rawData = chunkData();
+    size_t s = chunkDataSize();
+    if (s != rawData.size) {
+        throw std::runtime_error("cannot read " + std::to_string(s) +
+                                 " bytes from a dataset of size " +
+                                 std::to_string(rawData.size));
+    }
+    return rawData;
+}
+
+std::vector<Dataset::ConstDataPointer> Dataset::chunkDataOfFrames(
+        size_t firstFrame,
+        size_t numberOfFrames) const {
+    if (!isChunkedByFrame())
+        throw std::runtime_error("dataset is not chunked frame by frame");
+    std::vector<ConstDataPointer> chunks;
+    for (size_t i = 0; i < numberOfFrames; ++i)
+        chunks.push_back(chunkDataOfFrame(firstFrame + i));
+    return chunks;
+}
+
+void Dataset::readChunkIndex() const {
+    if (isChunkedByFrame())
+        chunkIndex();
+}
+
+bool Dataset::isChunkedByFrame() const {
+    return isChunked() && _dim.size() == 3 &&
+           chunkShape() == std::vector<size_t>({1, _dim[1], _dim[2]});
+}
+
+const std::vector<H5DataLayoutMsg::ChunkRecord>& Dataset::chunkIndex() const {
+    // a failed attempt is repeated by the next call
+    std::call_once(_chunkIndex->read, [this] {
+        _chunkIndex->chunks =
+                _dataLayoutMsg.getChunkRecordsOfFrames(_dataSize, 0, _dim[0],
+                                                       _maxDim);
+    });
+    return _chunkIndex->chunks;
+}
+
+H5DataLayoutMsg::ChunkRecord Dataset::chunkRecord(
+        const std::vector<size_t>& chunkOffset) const {
+    if (isChunkedByFrame() && chunkOffset.size() == 3 && chunkOffset[1] == 0 &&
+        chunkOffset[2] == 0)
+    {
+        return chunkRecordOfFrame(chunkOffset[0]);
+    }
+    return _dataLayoutMsg.getChunkRecord(_dataSize, chunkOffset, _maxDim);
+}
+
+H5DataLayoutMsg::ChunkRecord Dataset::chunkRecordOfFrame(size_t frame) const {
+    const auto& chunks = chunkIndex();
+    if (frame >= chunks.size() && frame < _dim[0]) {
+        // not in the part of the index which could be read
+        return _dataLayoutMsg.getChunkRecord(_dataSize, {frame, 0, 0},
+                                             _maxDim);
+    }
+    if (frame >= chunks.size() ||
+        chunks[frame].address == H5ChunkRecord::UNDEFINED_ADDRESS)
+    {
+        throw std::out_of_range("chunk of frame " + std::to_string(frame) +
+                                " not found");
+    }
+    return chunks[frame];
+}
+
+Dataset::ConstDataPointer Dataset::chunkDataOfFrame(size_t frame) const {
+    H5DataLayoutMsg::ChunkRecord chunk = chunkRecordOfFrame(frame);
+    return ConstDataPointer{_h5File.fileAddress() + chunk.address, chunk.size};
+}
+
+void Dataset::readFrames(size_t firstFrame,
+                         size_t numberOfFrames,
+                         void* data,
+                         const ReadFramesOptions& options) const {
+    if (_dim.empty() || firstFrame > _dim[0] ||
+        numberOfFrames > _dim[0] - firstFrame)
+    {
+        throw std::out_of_range("cannot read frames " +
+                                std::to_string(firstFrame) + " to " +
+                                std::to_string(firstFrame + numberOfFrames) +
+                                " of " + std::to_string(_dim[0]));
+    }
+    if (numberOfFrames == 0)
+        return;
+    char* frames = (char*)data;
+    if (!isChunked()) {
+        ConstDataPointer rawData = chunkData();
+        size_t s = chunkDataSize();
+        if (s != rawData.size) {
+            throw std::runtime_error("cannot read " + std::to_string(s) +
+                                     " bytes from a dataset of size " +
+                                     std::to_string(rawData.size));
+        }
+        size_t frameSize = s / _dim[0];
+        memcpy(frames, rawData.data + firstFrame * frameSize,
+               numberOfFrames * frameSize);
+        return;
+    }
+    if (!isChunkedByFrame()) {
+        readFramesFromChunks(firstFrame, numberOfFrames, frames, options);
+        return;
+    }
+    size_t frameSize = chunkDataSize();
+    std::vector<ConstDataPointer> chunks =
+            chunkDataOfFrames(firstFrame, numberOfFrames);
+    auto readFrame = [&](size_t i) {
+        readChunk(chunks[i], frames + i * frameSize);
+    };
+    if (options.threadPool) {
+        options.threadPool->parallelFor(numberOfFrames, readFrame);
+    } else {
+        for (size_t i = 0; i < numberOfFrames; ++i)
+            readFrame(i);
+    }
+}
+
+ChunkCache& Dataset::chunkCache() const {
+    return *_chunkCache;
+}
+
+void Dataset::readRegion(size_t frame,
+                         size_t y0,
+                         size_t y1,
+                         size_t x0,
+                         size_t x1,
+                         void* data) const {
+    readRegion(frame, y0, y1, x0, x1, data, ParallelFor());
+}
+
+void Dataset::readRegion(size_t frame,
+                         size_t y0,
+                         size_t y1,
+                         size_t x0,
+                         size_t x1,
+                         void* data,
+                         ThreadPool& threadPool) const {
+    readRegion(frame, y0, y1, x0, x1, data,
+               [&threadPool](size_t numberOfTasks,
+                             const std::function<void(size_t)>& task) {
+                   threadPool.parallelFor(numberOfTasks, task);
+               });
+}
+
+void Dataset::readRegion(size_t frame,
+                         size_t y0,
+                         size_t y1,
+                         size_t x0,
+                         size_t x1,
+                         void* data,
+                         const ParallelFor& parallelFor) const {
+    if (_dim.size() != 3 || frame >= _dim[0] || y0 > y1 || y1 > _dim[1] ||
+        x0 > x1 || x1 > _dim[2])
+    {
+        throw std::out_of_range(
+                "cannot read region [" + std::to_string(y0) + ", " +
+                std::to_string(y1) + ") x [" + std::to_string(x0) + ", " +
+                std::to_string(x1) + ") of frame " + std::to_string(frame));
+    }
+    if (y0 == y1 || x0 == x1)
+        return;
+    size_t width = _dim[2];
+    size_t frameSize = _dim[1] * width * _dataSize;
+    char* region = (char*)data;
+    // Calls visit(y, begin, end) for the rows y of the region which overlap
+    // the bytes [offset, offset + size) of the frame, with the overlapping
+    // elements [begin, end) of the frame. Stops when visit returns true.
+    auto forEachRow = [&](size_t offset, size_t size,
+                          const std::function<bool(size_t, size_t, size_t)>&
+                                  visit) {
+        size_t first = offset / _dataSize;
+        size_t last = (offset + size) / _dataSize;
+        size_t yEnd = std::min(y1, (last + width - 1) / width);
+        for (size_t y = std::max(y0, first / width); y < yEnd; ++y) {
+            size_t begin = std::max(y * width + x0, first);
+            size_t end = std::min(y * width + x1, last);
+            if (begin < end && visit(y, begin, end))
+                return;
+        }
+    };
+    auto isBlockNeeded = [&](size_t offset, size_t size) {
+        bool needed = false;
+        forEachRow(offset, size, [&](size_t, size_t, size_t) {
+            needed = true;
+            return true;
+        });
+        return needed;
+    };
+    // blocks are decoded concurrently, but write to different elements
+    auto copyToRegion = [&](const char* block, size_t offset, size_t size) {
+        forEachRow(offset, size, [&](size_t y, size_t begin, size_t end) {
+            memcpy(region + ((y - y0) * (x1 - x0) + begin - y * width - x0) *
+                                    _dataSize,
+                   block + begin * _dataSize - offset,
+                   (end - begin) * _dataSize);
+            return false;
+        });
+    };
+
+    if (!isChunked()) {
+        ConstDataPointer rawData = chunkData();
+        if (chunkDataSize() != rawData.size) {
+            throw std::runtime_error(
+                    "cannot read " + std::to_string(chunkDataSize()) +
+                    " bytes from a dataset of size " +
+                    std::to_string(rawData.size));
+        }
+        copyToRegion(rawData.data + frame * frameSize, 0, frameSize);
+        return;
+    }
+    if (!isChunkedByFrame()) {
+        std::vector<char> buffer(frameSize);
+        readFrames(frame, 1, buffer.data());
+        copyToRegion(buffer.data(), 0, frameSize);
+        return;
+    }
+    ConstDataPointer rawData = chunkDataOfFrame(frame);
+    size_t s = frameSize;
+    switch (_filterId) {
+        case -1:
+            if (s != rawData.size) {
+                throw std::runtime_error(
+                        "cannot read " + std::to_string(s) +
+                        " bytes from a dataset of size " +
+                        std::to_string(rawData.size));
+            }
+            copyToRegion(rawData.data, 0, s);
+            break;
+        case LZ4_FILTER:
+            lz4DecodeBlocks(rawData.data, s, _dataSize, isBlockNeeded,
+                            copyToRegion, parallelFor);
+            break;
+        case BSHUF_H5FILTER:
+            assert(_filterCdValues.size() > 4);
+            assert(_filterCdValues[4] == BSHUF_H5_COMPRESS_LZ4);
+            bshufUncompressLz4Blocks(rawData.data, s, _filterCdValues[2],
+                                     isBlockNeeded, copyToRegion, parallelFor);
+            break;
+        default:
+            throw std::runtime_error("filter " + std::to_string(_filterId) +
+                                     " not supported.");
+    }
+}
+
+void Dataset::readFramesFromChunks(size_t firstFrame,
+                                   size_t numberOfFrames,
+                                   char* frames,
+                                   const ReadFramesOptions& options) const {
+    std::vector<size_t> shape = chunkShape();
+    size_t rank = shape.size();
+    // offsets of the chunks holding a part of the frames, in the order in
+    // which they are stored
+    std::vector<std::vector<size_t>> chunkOffsets;
+    std::vector<size_t> offset(rank, 0);
+    offset[0] = firstFrame - firstFrame % shape[0];
+    while (offset[0] < firstFrame + numberOfFrames) {
+        chunkOffsets.push_back(offset);
+        size_t i = rank - 1;
+        for (; i > 0; --i) {
+            offset[i] += shape[i];
+            if (offset[i] < _dim[i])
+                break;
+            offset[i] = 0;
+        }
+        if (i == 0)
+            offset[0] += shape[0];
+    }
+    // looked up in one walk of the chunk index
+    std::vector<H5DataLayoutMsg::ChunkRecord> chunks =
+            _dataLayoutMsg.getChunkRecords(_dataSize, chunkOffsets, _maxDim);
+    for (const auto& chunk : chunks) {
+        if (chunk.address == H5DataLayoutMsg::ChunkRecord::UNDEFINED_ADDRESS)
+            throw std::out_of_range("chunk not found");
+    }
+    // the chunks write to different parts of the frames
+    auto readChunkOfFrames = [&](size_t i) {
+        ConstDataPointer rawData{_h5File.fileAddress() + chunks[i].address,
+                                 chunks[i].size};
+        ChunkCache::ChunkData chunk = _chunkCache->read(
+                rawData.data - _h5File.fileAddress(), chunkDataSize(),
+                [&](char* data) { readChunk(rawData, data); });
+        copyFromChunk(chunk->data(), chunkOffsets[i], firstFrame,
+                      numberOfFrames, frames);
+    };
+    if (options.threadPool) {
+        options.threadPool->parallelFor(chunkOffsets.size(), readChunkOfFrames);
+    } else {
+        for (size_t i = 0; i < chunkOffsets.size(); ++i)
+            readChunkOfFrames(i);
+    }
+}
+
+void Dataset::copyFromChunk(const char* chunk,
+                            const std::vector<size_t>& chunkOffset,
+                            size_t firstFrame,
+                            size_t numberOfFrames,
+                            char* frames) const {
+    std::vector<size_t> shape = chunkShape();
+    size_t rank = shape.size();
+    // the part of the chunk inside the frames and the dataset, edge chunks
+    // reach beyond the dataset
+    std::vector<size_t> begin(rank, 0);
+    std::vector<size_t> end(rank);
+    for (size_t i = 0; i < rank; ++i)
+        end[i] = std::min(shape[i], _dim[i] - chunkOffset[i]);
+    if (firstFrame > chunkOffset[0])
+        begin[0] = firstFrame - chunkOffset[0];
+    end[0] = std::min(end[0], firstFrame + numberOfFrames - chunkOffset[0]);
+
+    // copied one row of the last dimension at a time
+    size_t rowSize = (end[rank - 1] - begin[rank - 1]) * _dataSize;
+    std::vector<size_t> position(begin);
+    while (true) {
+        size_t chunkIndex = position[0];
+        size_t framesIndex = chunkOffset[0] + position[0] - firstFrame;
+        for (size_t i = 1; i < rank; ++i) {
+            chunkIndex = chunkIndex * shape[i] + position[i];
+            framesIndex = framesIndex * _dim[i] + chunkOffset[i] + position[i];
+        }
+        memcpy(frames + framesIndex * _dataSize, chunk + chunkIndex * _dataSize,
+               rowSize);
+        size_t i = rank - 1;
+        while (i > 0 && ++position[i - 1] == end[i - 1]) {
+            position[i - 1] = begin[i - 1];
+            --i;
+        }
+        if (i == 0)
+            return;
+    }
+}
+
+void Dataset::readChunk(ConstDataPointer rawData, void* data) const {
+    readChunk(rawData, data, ParallelFor());
+}
+
+void Dataset::readChunk(ConstDataPointer rawData,
+                        void* data,
+                        ThreadPool& threadPool) const {
+    readChunk(rawData, data,
+              [&threadPool](size_t numberOfTasks,
+                            const std::function<void(size_t)>& task) {
+                  threadPool.parallelFor(numberOfTasks, task);
+              });
+}
+
+void Dataset::readChunk(ConstDataPointer rawData,
+                        void* data,
+                        const ParallelFor& parallelFor) const {
     size_t s = chunkDataSize();
     switch (_filterId) {
         case -1:
             readRawData(rawData, data, s);
             break;
         case LZ4_FILTER:
-            readLz4Data(rawData, data, s);
+            readLz4Data(rawData, data, s, parallelFor);
             break;
         case BSHUF_H5FILTER:
-            readBitshuffleData(rawData, data, s);
+            readBitshuffleData(rawData, data, s, parallelFor);
             break;
         default:
             throw std::runtime_error("filter " + std::to_string(_filterId) +
@@ -134,8 +657,12 @@ void Dataset::parseDataSymbolTable() {
             case H5DataspaceMsg::TYPE_ID: {
                 H5DataspaceMsg dataspaceMsg(msg.object);
                 _dim.clear();
+                _maxDim.clear();
                 for (size_t i = 0; i < dataspaceMsg.rank(); ++i) {
                     _dim.push_back(dataspaceMsg.dim(i));
+                    _maxDim.push_back(dataspaceMsg.maxDims()
+                                              ? dataspaceMsg.maxDim(i)
+                                              : dataspaceMsg.dim(i));
                 }
                 break;
             }
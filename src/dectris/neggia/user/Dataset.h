@@ -3,20 +3,61 @@
 #ifndef DATASET_H
 #define DATASET_H
 
+#include <dectris/neggia/data/Decode.h>
 #include <dectris/neggia/data/H5DataLayoutMsg.h>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
+#include "ChunkCache.h"
 #include "H5File.h"
+#include "ThreadPool.h"
 
 class H5LinkMsg;
 class H5LinkInfoMsg;
 
 class Dataset {
 public:
+    typedef H5DataLayoutMsg::ConstDataPointer ConstDataPointer;
+    // Called with consecutive pieces of a chunk: the decoded (aligned)
+    // elements, the index of the first element and the number of elements.
+    // The data is only valid during the call.
+    typedef std::function<void(const void*, size_t, size_t)> BlockCallback;
+    // A chunk as it is stored in the file, e.g. to copy compressed chunks to
+    // another file without decoding and encoding them again
+    struct RawChunk {
+        // points into the mapped file like chunkData()
+        ConstDataPointer data;
+        // of the filter pipeline of the dataset, -1 if it has no filter
+        int filterId;
+        std::vector<int32_t> filterCdValues;
+        // bit 0 is set if the filter was not applied to this chunk
+        uint32_t filterMask;
+    };
+    struct ReadFramesOptions {
+        ReadFramesOptions() : threadPool(nullptr) {}
+        // decodes several frames at the same time if set
+        ThreadPool* threadPool;
+    };
+
     Dataset();
     Dataset(const H5File& h5File, const std::string& path);
+    // Opens the dataset with the object header at objectHeaderAddress in
+    // h5File without resolving a path, e.g. from a previously stored
+    // objectHeaderAddress()
+    Dataset(const H5File& h5File, size_t objectHeaderAddress);
     ~Dataset();
+    // Like the constructor, but returns false instead of throwing
+    // std::out_of_range if the path does not exist, neither in h5File nor in
+    // the target file of an external link. Meant for optional datasets,
+    // which are then looked up without throwing and catching an exception.
+    static bool tryOpen(const H5File& h5File,
+                        const std::string& path,
+                        Dataset& dataset);
+
+    // The file containing the dataset, after following external links
+    const H5File& h5File() const;
+    size_t objectHeaderAddress() const;
 
     unsigned int dataTypeId() const;
     size_t dataSize() const;
@@ -25,33 +66,162 @@ public:
     bool isChunked() const;
     std::vector<size_t> chunkShape() const;
 
-    // chunkOffset is ignored for contigous or raw datasets
+    // Reads the chunk which starts at chunkOffset, chunkDataSize() bytes.
+    // chunkOffset is ignored for contigous or raw datasets.
     void read(void* data,
               const std::vector<size_t>& chunkOffset =
                       std::vector<size_t>()) const;
 
+    // Location of the (possibly compressed) chunk in the mapped file.
+    // The pointer stays valid as long as this Dataset or a copy of its
+    // H5File is alive.
+    ConstDataPointer chunkData(const std::vector<size_t>& chunkOffset =
+                                       std::vector<size_t>()) const;
+    // Like chunkData(), with the filter of the chunk
+    RawChunk rawChunk(const std::vector<size_t>& chunkOffset =
+                              std::vector<size_t>()) const;
+    // The elements of a contiguous or compact dataset in the mapped file, in
+    // C order, without copying them. The pointer stays valid as long as this
+    // Dataset or a copy of its H5File is alive and is not necessarily aligned
+    // to the element size. Throws std::runtime_error for chunked datasets.
+    ConstDataPointer view() const;
+    // Chunks of frames [firstFrame, firstFrame + numberOfFrames) of a dataset
+    // which is chunked frame by frame
+    std::vector<ConstDataPointer> chunkDataOfFrames(
+            size_t firstFrame,
+            size_t numberOfFrames) const;
+    // The chunks of datasets which are chunked frame by frame are looked up
+    // in a copy of the chunk index of the file, which is read when the first
+    // chunk is looked up, or when this is called. Copies of the Dataset
+    // share it.
+    void readChunkIndex() const;
+    // Decodes a chunk previously returned by chunkData()
+    void readChunk(ConstDataPointer rawData, void* data) const;
+    // Decodes a chunk previously returned by chunkData() one compression
+    // block at a time, so that the caller can process each block while it is
+    // still in the cache instead of making a second pass over the chunk.
+    void readChunkBlocks(ConstDataPointer rawData,
+                         const BlockCallback& blockCallback) const;
+
+    // Like read(), readChunk() and readChunkBlocks(), but decode the
+    // compression blocks of an LZ4 or bitshuffle/LZ4 chunk concurrently on
+    // the calling thread and the threads of threadPool, to reduce the latency
+    // of reading a single large frame. blockCallback is called concurrently
+    // for different blocks. Uncompressed chunks are read on the calling
+    // thread.
+    void read(void* data,
+              const std::vector<size_t>& chunkOffset,
+              ThreadPool& threadPool) const;
+    void readChunk(ConstDataPointer rawData,
+                   void* data,
+                   ThreadPool& threadPool) const;
+    void readChunkBlocks(ConstDataPointer rawData,
+                         const BlockCallback& blockCallback,
+                         ThreadPool& threadPool) const;
+
+    // Reads frames [firstFrame, firstFrame + numberOfFrames), i.e. the
+    // entries of the first dimension, into consecutive frames of data. On a
+    // thread pool, every thread takes the next frame (or chunk) as soon as it
+    // is done with the previous one, so that frames which take long to
+    // decode do not hold up the others. Chunks of other shapes than one
+    // frame, e.g. of several frames or of a part of a frame, are decoded
+    // through chunkCache(), so that reading the frames of a chunk one by one
+    // decodes the chunk only once.
+    void readFrames(size_t firstFrame,
+                    size_t numberOfFrames,
+                    void* data,
+                    const ReadFramesOptions& options =
+                            ReadFramesOptions()) const;
+
+    // Reads the region [y0, y1) x [x0, x1) of a frame of a 3-dimensional
+    // dataset into data, (y1 - y0) * (x1 - x0) elements. Of frames which are
+    // chunked frame by frame with LZ4 or bitshuffle/LZ4 only the compression
+    // blocks which hold a part of the region are decoded, e.g. about a tenth
+    // of the blocks for the central 512 x 512 pixels of a 4150 x 4371 frame.
+    // Frames of other chunk shapes are read through readFrames(). The
+    // ThreadPool overload decodes the blocks concurrently.
+    void readRegion(size_t frame,
+                    size_t y0,
+                    size_t y1,
+                    size_t x0,
+                    size_t x1,
+                    void* data) const;
+    void readRegion(size_t frame,
+                    size_t y0,
+                    size_t y1,
+                    size_t x0,
+                    size_t x1,
+                    void* data,
+                    ThreadPool& threadPool) const;
+
+    // Decoded chunks kept by readFrames(), shared by the copies of this
+    // Dataset. Its budget (ChunkCache::DEFAULT_MAX_BYTES) can be changed with
+    // chunkCache().setMaxBytes().
+    ChunkCache& chunkCache() const;
+
 private:
-    typedef H5DataLayoutMsg::ConstDataPointer ConstDataPointer;
+    struct ChunkIndex;
 
+    // follows external links, false if the path does not exist
+    bool resolvePath(const std::string& path);
     void parseDataSymbolTable();
+    bool isChunkedByFrame() const;
+    const std::vector<H5DataLayoutMsg::ChunkRecord>& chunkIndex() const;
+    H5DataLayoutMsg::ChunkRecord chunkRecord(
+            const std::vector<size_t>& chunkOffset) const;
+    H5DataLayoutMsg::ChunkRecord chunkRecordOfFrame(size_t frame) const;
+    ConstDataPointer chunkDataOfFrame(size_t frame) const;
+    // parallelFor is only set for the ThreadPool overloads
+    void readChunk(ConstDataPointer rawData,
+                   void* data,
+                   const ParallelFor& parallelFor) const;
+    void readChunkBlocks(ConstDataPointer rawData,
+                         const BlockCallback& blockCallback,
+                         const ParallelFor& parallelFor) const;
     void readRawData(ConstDataPointer rawData,
                      void* outData,
                      size_t outDataSize) const;
-    void readLz4Data(ConstDataPointer rawData, void* data, size_t s) const;
+    void readLz4Data(ConstDataPointer rawData,
+                     void* data,
+                     size_t s,
+                     const ParallelFor& parallelFor) const;
     void readBitshuffleData(ConstDataPointer rawData,
                             void* data,
-                            size_t s) const;
+                            size_t s,
+                            const ParallelFor& parallelFor) const;
+    void readRegion(size_t frame,
+                    size_t y0,
+                    size_t y1,
+                    size_t x0,
+                    size_t x1,
+                    void* data,
+                    const ParallelFor& parallelFor) const;
+    void readFramesFromChunks(size_t firstFrame,
+                              size_t numberOfFrames,
+                              char* frames,
+                              const ReadFramesOptions& options) const;
+    // copies the part of the decoded chunk at chunkOffset which belongs to
+    // the frames
+    void copyFromChunk(const char* chunk,
+                       const std::vector<size_t>& chunkOffset,
+                       size_t firstFrame,
+                       size_t numberOfFrames,
+                       char* frames) const;
     size_t chunkDataSize() const;
 
     H5File _h5File;
     H5ObjectHeader _dataSymbolObjectHeader;
     H5DataLayoutMsg _dataLayoutMsg;
     std::vector<size_t> _dim;
+    // H5_UNLIMITED for unlimited dimensions
+    std::vector<size_t> _maxDim;
     int _filterId;
     std::vector<int32_t> _filterCdValues;
     size_t _dataSize;
     int _dataTypeId;
     bool _isSigned;
+    std::shared_ptr<ChunkIndex> _chunkIndex;
+    std::shared_ptr<ChunkCache> _chunkCache;
 };
 
 #endif  // DATASET_H
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: MIT
+
+#include "Group.h"
+#include <dectris/neggia/data/H5LinkInfoMessage.h>
+#include <dectris/neggia/data/H5SymbolTableMsg.h>
+#include <dectris/neggia/data/constants.h>
+#include <stdexcept>
+
+namespace {
+// https://support.hdfgroup.org/HDF5/doc/H5.format.html#GroupInfoMessage
+constexpr unsigned int GROUP_INFO_MSG_TYPE_ID = 0x0a;
+
+Group::Link linkOf(const H5LinkMsg& linkMsg) {
+    Group::Link link{linkMsg.linkName(), linkMsg.linkType(),
+                     H5_INVALID_ADDRESS, {}, {}};
+    switch (link.type) {
+        case H5LinkMsg::HARD:
+            link.objectHeaderAddress = linkMsg.hardLinkObjectHeader().offset();
+            break;
+        case H5LinkMsg::SOFT:
+            link.targetPath = linkMsg.targetPath();
+            break;
+        case H5LinkMsg::EXTERNAL:
+            link.targetFile = linkMsg.targetFile();
+            link.targetPath = linkMsg.targetPath();
+            break;
+    }
+    return link;
+}
+
+Group::Link linkOf(const H5SymbolTableEntry& entry, const H5LocalHeap& heap) {
+    Group::Link link{heap.data(entry.linkNameOffset()), H5LinkMsg::HARD,
+                     entry.read_u64(8), {}, {}};
+    if (entry.cacheType() == H5SymbolTableEntry::LINK) {
+        link.type = H5LinkMsg::SOFT;
+        link.objectHeaderAddress = H5_INVALID_ADDRESS;
+        link.targetPath = heap.data(entry.getOffsetToLinkValue());
+    }
+    return link;
+}
+}  // namespace
+
+Group::Group(const H5File& h5File, const std::string& path) : _h5File(h5File) {
+    try {
+        auto resolvedPath = _h5File.resolve(path);
+        while (resolvedPath.externalFile) {
+            auto targetFile = resolvedPath.externalFile->filename;
+            if (targetFile[0] != '/')
+                targetFile = _h5File.fileDir() + "/" + targetFile;
+            _h5File = H5File(targetFile);
+            resolvedPath = _h5File.resolve(resolvedPath.externalFile->h5Path);
+        }
+        _objectHeader = resolvedPath.objectHeader;
+    } catch (std::exception& exc) {
+        throw std::out_of_range(exc.what());
+    }
+    if (!isGroup(_objectHeader))
+        throw std::runtime_error(path + " is not a group");
+}
+
+Group::Group(const H5File& h5File, size_t objectHeaderAddress)
+      : _h5File(h5File),
+        _objectHeader(h5File.fileAddress(), objectHeaderAddress) {
+    if (!isGroup(_objectHeader))
+        throw std::runtime_error("object header is not a group");
+}
+
+const H5File& Group::h5File() const {
+    return _h5File;
+}
+
+size_t Group::objectHeaderAddress() const {
+    return _objectHeader.offset();
+}
+
+void Group::forEachLink(const LinkCallback& linkCallback) const {
+    for (int i = 0; i < _objectHeader.numberOfMessages(); ++i) {
+        auto msg = _objectHeader.headerMessage(i);
+        switch (msg.type) {
+            case H5LinkMsg::TYPE_ID:
+                linkCallback(linkOf(H5LinkMsg(msg.object)));
+                break;
+            case H5LinkInfoMsg::TYPE_ID: {
+                H5LinkInfoMsg linkInfoMsg(msg.object);
+                if (!linkInfoMsg.hasDenseStorage())
+                    break;
+                for (const auto& linkMsg :
+                     linkInfoMsg.getLinkMessages(_h5File.fileAddress()))
+                {
+                    linkCallback(linkOf(linkMsg));
+                }
+                break;
+            }
+            case H5SymbolTableMsg::TYPE_ID: {
+                H5SymbolTableMsg symbolTableMsg(msg.object);
+                H5LocalHeap heap = symbolTableMsg.localHeap();
+                symbolTableMsg.forEachEntry(
+                        [&](const H5SymbolTableEntry& entry) {
+                            linkCallback(linkOf(entry, heap));
+                        });
+                break;
+            }
+        }
+    }
+}
+
+std::vector<Group::Link> Group::links() const {
+    std::vector<Link> result;
+    forEachLink([&](const Link& link) { result.push_back(link); });
+    return result;
+}
+
+void Group::visit(const VisitCallback& visitCallback) const {
+    std::set<size_t> visitedGroups{objectHeaderAddress()};
+    visit("", visitedGroups, visitCallback);
+}
+
+void Group::visit(const std::string& prefix,
+                  std::set<size_t>& visitedGroups,
+                  const VisitCallback& visitCallback) const {
+    forEachLink([&](const Link& link) {
+        std::string path = prefix + link.name;
+        visitCallback(path, link);
+        if (link.type != H5LinkMsg::HARD ||
+            !visitedGroups.insert(link.objectHeaderAddress).second)
+        {
+            return;
+        }
+        H5ObjectHeader objectHeader(_h5File.fileAddress(),
+                                    link.objectHeaderAddress);
+        if (isGroup(objectHeader)) {
+            Group group;
+            group._h5File = _h5File;
+            group._objectHeader = objectHeader;
+            group.visit(path + "/", visitedGroups, visitCallback);
+        }
+    });
+}
+
+bool Group::isGroup(const H5ObjectHeader& objectHeader) {
+    for (int i = 0; i < objectHeader.numberOfMessages(); ++i) {
+        switch (objectHeader.headerMessage(i).type) {
+            case GROUP_INFO_MSG_TYPE_ID:
+            case H5LinkInfoMsg::TYPE_ID:
+            case H5LinkMsg::TYPE_ID:
+            case H5SymbolTableMsg::TYPE_ID:
+                return true;
+        }
+    }
+    return false;
+}
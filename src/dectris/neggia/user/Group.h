@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef GROUP_H
+#define GROUP_H
+#include <dectris/neggia/data/H5LinkMsg.h>
+#include <dectris/neggia/data/H5ObjectHeader.h>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+#include "H5File.h"
+
+// A group of an HDF5 file whose links can be listed without knowing their
+// names, e.g. to find all data_NNNNNN links of /entry/data of a master file.
+// The links are read in one pass over their storage, whether they are kept in
+// link messages of the object header, in dense storage (fractal heap indexed
+// by a version 2 B-tree) or in a symbol table (files written with the
+// earliest file format).
+class Group {
+public:
+    struct Link {
+        std::string name;
+        H5LinkMsg::LinkType type;
+        // address of the object header of the target of a hard link
+        size_t objectHeaderAddress;
+        // file of an external link
+        std::string targetFile;
+        // path of a soft or external link
+        std::string targetPath;
+    };
+    typedef std::function<void(const Link& link)> LinkCallback;
+    // path of the link relative to the visited group
+    typedef std::function<void(const std::string& path, const Link& link)>
+            VisitCallback;
+
+    Group() = default;
+    // External links to the group are followed. Throws std::out_of_range if
+    // the path does not exist and std::runtime_error if it is not a group.
+    Group(const H5File& h5File, const std::string& path);
+    Group(const H5File& h5File, size_t objectHeaderAddress);
+    // file which contains the group, which is the target file of external
+    // links
+    const H5File& h5File() const;
+    size_t objectHeaderAddress() const;
+
+    // Calls linkCallback for every link of the group. Links in link messages
+    // and symbol tables are reported in the order in which they are stored,
+    // links in dense storage in the order of the hashes of their names.
+    void forEachLink(const LinkCallback& linkCallback) const;
+    std::vector<Link> links() const;
+    // Calls visitCallback for every link of the group and, depth first, of
+    // the groups which are reached through hard links. Groups reached
+    // through several hard links are visited once. Soft and external links
+    // are reported but not followed.
+    void visit(const VisitCallback& visitCallback) const;
+
+    // Whether the object header has the messages of a group
+    static bool isGroup(const H5ObjectHeader& objectHeader);
+
+private:
+    void visit(const std::string& prefix,
+               std::set<size_t>& visitedGroups,
+               const VisitCallback& visitCallback) const;
+
+    H5File _h5File;
+    H5ObjectHeader _objectHeader;
+};
+
+#endif  // GROUP_H
@@ -7,42 +7,201 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include "PathCatalog.h"
 
 namespace {
 
+constexpr size_t DEFAULT_MAX_MAPPED_FILES = 64;
+
 struct UnMap {
     size_t size;
     void operator()(char* addr) { munmap(addr, size); }
 };
 
-std::shared_ptr<char> mapFile(const std::string& fileName) {
-#ifdef DEBUG_PARSING
-    std::cerr << "opening file " << fileName << "\n";
-#endif
-    int fd = open(fileName.c_str(), O_RDONLY);
-    if (fd < 0) {
-        std::cerr << "NEGGIA ERROR: OPENING FILE RETURNED ERROR CODE: " << errno
-                  << std::endl;
-        throw std::out_of_range("Cannot open file");
+struct FileIdentity {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+
+    explicit FileIdentity(const struct stat& status)
+          : device(status.st_dev),
+            inode(status.st_ino),
+            size(status.st_size) {}
+    bool operator<(const FileIdentity& other) const {
+        return std::tie(device, inode, size) <
+               std::tie(other.device, other.inode, other.size);
+    }
+    bool operator==(const FileIdentity& other) const {
+        return device == other.device && inode == other.inode &&
+               size == other.size;
     }
-    off_t fsize = lseek(fd, 0, SEEK_END);
-    lseek(fd, 0, SEEK_SET);
+};
+
+void throwCannotOpen() {
+    std::cerr << "NEGGIA ERROR: OPENING FILE RETURNED ERROR CODE: " << errno
+              << std::endl;
+    throw std::out_of_range("Cannot open file");
+}
+
+std::shared_ptr<char> mapFile(int fd, size_t fsize) {
     char* filePointer = (char*)mmap(NULL, fsize, PROT_READ, MAP_SHARED, fd, 0);
     if (filePointer == MAP_FAILED) {
-        close(fd);
         std::cerr << "NEGGIA ERROR: MAPPING FILE RETURNED ERROR CODE: " << errno
                   << std::endl;
         throw std::out_of_range("Cannot map file");
     }
-    close(fd);
     UnMap deleter;
     deleter.size = fsize;
     return std::shared_ptr<char>(filePointer, deleter);
 }
 
+// A mapped file and the paths resolved in it
+struct MappedFile {
+    explicit MappedFile(const std::shared_ptr<char>& address)
+          : address(address), pathCatalog(address.get()) {}
+    std::shared_ptr<char> address;
+    PathCatalog pathCatalog;
+};
+
+// Process wide registry of mapped files. The registry keeps the mappings of
+// the maxMappedFiles most recently used files alive, all other mappings live
+// as long as they are used by an H5File.
+class MappedFiles {
+public:
+    static MappedFiles& instance() {
+        static MappedFiles mappedFiles;
+        return mappedFiles;
+    }
+
+    std::shared_ptr<MappedFile> map(const std::string& fileName) {
+#ifdef DEBUG_PARSING
+        std::cerr << "opening file " << fileName << "\n";
+#endif
+        struct stat status;
+        if (stat(fileName.c_str(), &status) != 0)
+            throwCannotOpen();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto mapping = find(FileIdentity(status));
+            if (mapping)
+                return mapping;
+        }
+        // The file may have been replaced since stat(), the mapping is
+        // registered with the identity of the file which was opened.
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            throwCannotOpen();
+        if (fstat(fd, &status) != 0) {
+            close(fd);
+            throwCannotOpen();
+        }
+        FileIdentity identity(status);
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto mapping = find(identity);
+        if (!mapping) {
+            try {
+                mapping = std::make_shared<MappedFile>(
+                        mapFile(fd, status.st_size));
+            } catch (const std::out_of_range&) {
+                close(fd);
+                throw;
+            }
+            removeUnusedEntries();
+            _recentlyUsed.push_front(identity);
+            _mappings[identity] =
+                    Entry{mapping, mapping, _recentlyUsed.begin()};
+            releaseLeastRecentlyUsed();
+        }
+        close(fd);
+        return mapping;
+    }
+
+    void setMaxMappedFiles(size_t maxMappedFiles) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _maxMappedFiles = maxMappedFiles;
+        releaseLeastRecentlyUsed();
+    }
+
+    size_t maxMappedFiles() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _maxMappedFiles;
+    }
+
+private:
+    struct Entry {
+        std::weak_ptr<MappedFile> mapping;
+        // only set while the file is one of the most recently used files
+        std::shared_ptr<MappedFile> keptMapping;
+        std::list<FileIdentity>::iterator recentlyUsed;
+    };
+
+    MappedFiles() : _maxMappedFiles(DEFAULT_MAX_MAPPED_FILES) {}
+
+    std::shared_ptr<MappedFile> find(const FileIdentity& identity) {
+        auto entry = _mappings.find(identity);
+        if (entry == _mappings.end())
+            return nullptr;
+        auto mapping = entry->second.mapping.lock();
+        if (!mapping) {
+            _mappings.erase(entry);
+            return nullptr;
+        }
+        if (entry->second.keptMapping) {
+            _recentlyUsed.splice(_recentlyUsed.begin(), _recentlyUsed,
+                                 entry->second.recentlyUsed);
+        } else {
+            _recentlyUsed.push_front(identity);
+            entry->second.keptMapping = mapping;
+            entry->second.recentlyUsed = _recentlyUsed.begin();
+            releaseLeastRecentlyUsed();
+        }
+        return mapping;
+    }
+
+    // The file is unmapped unless it is still used by an H5File.
+    void releaseLeastRecentlyUsed() {
+        while (_recentlyUsed.size() > _maxMappedFiles) {
+            auto entry = _mappings.find(_recentlyUsed.back());
+            _recentlyUsed.pop_back();
+            entry->second.keptMapping.reset();
+            if (entry->second.mapping.expired())
+                _mappings.erase(entry);
+        }
+    }
+
+    // entries of unmapped files which are no longer used
+    void removeUnusedEntries() {
+        for (auto it = _mappings.begin(); it != _mappings.end();) {
+            if (it->second.mapping.expired())
+                it = _mappings.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    std::mutex _mutex;
+    size_t _maxMappedFiles;
+    std::map<FileIdentity, Entry> _mappings;
+    // most recently used first
+    std::list<FileIdentity> _recentlyUsed;
+};
+
 }  // namespace
 
-H5File::H5File(const std::string& path) : _fileAddress(mapFile(path)) {
+struct H5File::Mapping {
+    std::once_flag mapped;
+    std::shared_ptr<MappedFile> file;
+};
+
+H5File::H5File(const std::string& path)
+      : _mapping(std::make_shared<Mapping>()), _path(path) {
+    if (access(path.c_str(), R_OK) != 0)
+        throwCannotOpen();
     for (ssize_t i = path.size() - 1; i > 0; i--) {
         if (path[i] == '/') {
             _fileDir = std::string(path, 0, i);
@@ -56,9 +215,45 @@ H5File::H5File(const std::string& path) : _fileAddress(mapFile(path)) {
 H5File::~H5File() {}
 
 const char* H5File::fileAddress() const {
-    return _fileAddress.get();
+    if (!_mapping)
+        return nullptr;
+    std::call_once(_mapping->mapped, [this]() {
+        _mapping->file = MappedFiles::instance().map(_path);
+    });
+    return _mapping->file->address.get();
+}
+
+ResolvedPath H5File::resolve(const H5Path& path) const {
+    return pathCatalog().resolve(path);
+}
+
+bool H5File::tryResolve(const H5Path& path, ResolvedPath& resolvedPath) const {
+    return pathCatalog().tryResolve(path, resolvedPath);
+}
+
+bool H5File::exists(const H5Path& path) const {
+    ResolvedPath resolvedPath;
+    return tryResolve(path, resolvedPath);
+}
+
+PathCatalog& H5File::pathCatalog() const {
+    if (!fileAddress())
+        throw std::out_of_range("no file");
+    return _mapping->file->pathCatalog;
 }
 
 std::string H5File::fileDir() const {
     return _fileDir;
 }
+
+std::string H5File::path() const {
+    return _path;
+}
+
+void H5File::setMaxMappedFiles(size_t maxMappedFiles) {
+    MappedFiles::instance().setMaxMappedFiles(maxMappedFiles);
+}
+
+size_t H5File::maxMappedFiles() {
+    return MappedFiles::instance().maxMappedFiles();
+}
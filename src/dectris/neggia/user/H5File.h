@@ -2,9 +2,15 @@
 
 #ifndef H5FILE_H
 #define H5FILE_H
+#include <dectris/neggia/data/ResolvedPath.h>
 #include <memory>
 #include <string>
 
+class PathCatalog;
+
+// A memory mapped HDF5 file. Copies share the mapping, which is created on
+// the first call to fileAddress(). All H5File objects of the same file (same
+// device, inode and size) in a process share one mapping as well.
 class H5File {
 public:
     H5File() = default;
@@ -12,10 +18,32 @@ public:
     ~H5File();
     const char* fileAddress() const;
     std::string fileDir() const;
+    // path as passed to the constructor
+    std::string path() const;
+    // Resolves path in the file like H5Superblock::resolve. The resolved
+    // paths are remembered in pathCatalog(), which is shared by all H5File
+    // objects of the same file, so resolving a path again costs a hash
+    // lookup.
+    ResolvedPath resolve(const H5Path& path) const;
+    // Like resolve, returns false instead of throwing std::out_of_range if
+    // the path does not exist, e.g. to look for optional datasets
+    bool tryResolve(const H5Path& path, ResolvedPath& resolvedPath) const;
+    // Whether the path exists in this file. External links are not followed.
+    bool exists(const H5Path& path) const;
+    PathCatalog& pathCatalog() const;
+
+    // Mappings of files which are no longer used by any H5File are kept for
+    // later use, the least recently used ones are unmapped as soon as more
+    // than maxMappedFiles files are mapped. Files which are still used stay
+    // mapped.
+    static void setMaxMappedFiles(size_t maxMappedFiles);
+    static size_t maxMappedFiles();
 
 private:
-    std::shared_ptr<char> _fileAddress;
+    struct Mapping;
+    std::shared_ptr<Mapping> _mapping;
     std::string _fileDir;
+    std::string _path;
 };
 
 #endif  // H5FILE_H
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MIT
+
+#include "PathCatalog.h"
+#include <dectris/neggia/data/H5LinkInfoMessage.h>
+#include <dectris/neggia/data/H5Superblock.h>
+#include <stdexcept>
+
+namespace {
+ResolvedPath copyOf(const ResolvedPath& resolvedPath) {
+    ResolvedPath copy{resolvedPath.objectHeader, {}, {}};
+    if (resolvedPath.externalFile) {
+        copy.externalFile.reset(
+                new ResolvedPath::ExternalFile(*resolvedPath.externalFile));
+    }
+    if (resolvedPath.softLink)
+        copy.softLink.reset(new H5Path(*resolvedPath.softLink));
+    return copy;
+}
+}  // namespace
+
+PathCatalog::PathCatalog(const char* fileAddress)
+      : _fileAddress(fileAddress), _hits(0), _misses(0) {}
+
+ResolvedPath PathCatalog::resolve(const H5Path& path) {
+    ResolvedPath resolvedPath;
+    if (!tryResolve(path, resolvedPath))
+        throw std::out_of_range("could not find " + std::string(path));
+    return resolvedPath;
+}
+
+bool PathCatalog::tryResolve(const H5Path& path, ResolvedPath& resolvedPath) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto rememberedPath = _resolvedPaths.find(std::string(path));
+    if (rememberedPath != _resolvedPaths.end()) {
+        ++_hits;
+        resolvedPath = copyOf(rememberedPath->second);
+        return true;
+    }
+    ++_misses;
+    return tryResolveAndRemember(path, resolvedPath);
+}
+
+size_t PathCatalog::hits() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _hits;
+}
+
+size_t PathCatalog::misses() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _misses;
+}
+
+bool PathCatalog::tryResolveAndRemember(const H5Path& path,
+                                        ResolvedPath& resolvedPath) {
+    std::string key = path;
+    auto rememberedPath = _resolvedPaths.find(key);
+    if (rememberedPath != _resolvedPaths.end()) {
+        resolvedPath = copyOf(rememberedPath->second);
+        return true;
+    }
+    if (!resolveInDenseLinks(path, resolvedPath) &&
+        !H5Superblock(_fileAddress).tryResolve(path, resolvedPath))
+    {
+        return false;
+    }
+    _resolvedPaths[key] = copyOf(resolvedPath);
+    return true;
+}
+
+bool PathCatalog::resolveInDenseLinks(const H5Path& path,
+                                      ResolvedPath& resolvedPath) {
+    if (path.begin() == path.end())
+        return false;
+    std::string parentPath = path.isAbsolute() ? "/" : "";
+    for (auto item = path.begin(); item + 1 != path.end(); ++item)
+        parentPath += *item + "/";
+    ResolvedPath parent;
+    if (!tryResolveAndRemember(H5Path(parentPath), parent))
+        return false;
+    if (parent.externalFile || parent.softLink)
+        return false;
+    const Links* links = denseLinks(parent.objectHeader);
+    if (!links)
+        return false;
+    auto link = links->find(*(path.end() - 1));
+    // soft links and missing links are left to the path resolver
+    if (link == links->end())
+        return false;
+    switch (link->second.linkType()) {
+        case H5LinkMsg::HARD:
+            resolvedPath = ResolvedPath{link->second.hardLinkObjectHeader(),
+                                        {}, {}};
+            return true;
+        case H5LinkMsg::EXTERNAL:
+            resolvedPath = ResolvedPath{
+                    {},
+                    std::unique_ptr<ResolvedPath::ExternalFile>(
+                            new ResolvedPath::ExternalFile{
+                                    link->second.targetFile(),
+                                    H5Path(link->second.targetPath())}),
+                    {}};
+            return true;
+        default:
+            return false;
+    }
+}
+
+const PathCatalog::Links* PathCatalog::denseLinks(
+        const H5ObjectHeader& group) {
+    auto links = _denseLinks.find(group.offset());
+    if (links != _denseLinks.end())
+        return &links->second;
+    for (int i = 0; i < group.numberOfMessages(); ++i) {
+        auto msg = group.headerMessage(i);
+        if (msg.type != H5LinkInfoMsg::TYPE_ID)
+            continue;
+        H5LinkInfoMsg linkInfoMsg(msg.object);
+        if (!linkInfoMsg.hasDenseStorage())
+            return nullptr;
+        Links& groupLinks = _denseLinks[group.offset()];
+        for (const auto& linkMsg : linkInfoMsg.getLinkMessages(_fileAddress))
+            groupLinks[linkMsg.linkName()] = linkMsg;
+        return &groupLinks;
+    }
+    return nullptr;
+}
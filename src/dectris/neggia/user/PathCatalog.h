@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef PATHCATALOG_H
+#define PATHCATALOG_H
+#include <dectris/neggia/data/H5LinkMsg.h>
+#include <dectris/neggia/data/ResolvedPath.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Remembers the paths resolved in one file. Paths which were resolved before
+// are looked up in a hash map. The links of groups with dense link storage,
+// e.g. /entry/data with thousands of data_NNNNNN links, are read in one pass
+// the first time a link of the group is resolved, instead of looking up the
+// name hash in the B-tree and the link in the fractal heap for every link.
+class PathCatalog {
+public:
+    explicit PathCatalog(const char* fileAddress);
+
+    // Like H5Superblock::resolve. May be called concurrently.
+    ResolvedPath resolve(const H5Path& path);
+    // Like H5Superblock::tryResolve. Paths which do not exist are not
+    // remembered.
+    bool tryResolve(const H5Path& path, ResolvedPath& resolvedPath);
+    // resolve() calls answered from the resolved paths
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    typedef std::unordered_map<std::string, H5LinkMsg> Links;
+
+    bool tryResolveAndRemember(const H5Path& path, ResolvedPath& resolvedPath);
+    // resolves the last item of path in the dense links of its parent, sets
+    // resolvedPath and returns true if it was found there
+    bool resolveInDenseLinks(const H5Path& path, ResolvedPath& resolvedPath);
+    // nullptr if the group has no dense link storage
+    const Links* denseLinks(const H5ObjectHeader& group);
+
+    const char* _fileAddress;
+    mutable std::mutex _mutex;
+    std::unordered_map<std::string, ResolvedPath> _resolvedPaths;
+    // by the offset of the object header of the group
+    std::unordered_map<size_t, Links> _denseLinks;
+    size_t _hits;
+    size_t _misses;
+};
+
+#endif  // PATHCATALOG_H
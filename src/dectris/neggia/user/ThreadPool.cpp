@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: MIT
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace {
+
+struct ParallelForState {
+    ParallelForState(size_t numberOfTasks,
+                     const std::function<void(size_t)>& task)
+          : task(task),
+            numberOfTasks(numberOfTasks),
+            nextTask(0),
+            failed(false),
+            finishedTasks(0) {}
+
+    // only called for tasks which were taken before all tasks had finished,
+    // parallelFor() has not returned yet and the task is still valid
+    const std::function<void(size_t)>& task;
+    const size_t numberOfTasks;
+    std::atomic<size_t> nextTask;
+    std::atomic<bool> failed;
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t finishedTasks;
+    std::exception_ptr exception;
+};
+
+void runTasks(ParallelForState* state) {
+    size_t i;
+    while ((i = state->nextTask++) < state->numberOfTasks) {
+        if (!state->failed) {
+            try {
+                state->task(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->exception)
+                    state->exception = std::current_exception();
+                state->failed = true;
+            }
+        }
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (++state->finishedTasks == state->numberOfTasks)
+            state->finished.notify_all();
+    }
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t numberOfThreads) : _stop(false) {
+    if (numberOfThreads == 0)
+        numberOfThreads = 1;
+    for (size_t i = 0; i < numberOfThreads; ++i)
+        _threads.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+    for (auto& thread : _threads)
+        thread.join();
+}
+
+size_t ThreadPool::numberOfThreads() const {
+    return _threads.size();
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push_back(std::move(task));
+    }
+    _condition.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t numberOfTasks,
+                             const std::function<void(size_t)>& task) {
+    if (numberOfTasks == 0)
+        return;
+    // pool threads may only get to the state after all tasks have finished
+    auto state = std::make_shared<ParallelForState>(numberOfTasks, task);
+    size_t helpers = std::min(numberOfTasks - 1, numberOfThreads());
+    for (size_t i = 0; i < helpers; ++i)
+        enqueue([state]() { runTasks(state.get()); });
+    runTasks(state.get());
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state] {
+        return state->finishedTasks == state->numberOfTasks;
+    });
+    if (state->exception)
+        std::rethrow_exception(state->exception);
+}
+
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this] { return _stop || !_tasks.empty(); });
+            if (_tasks.empty())
+                return;
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        task();
+    }
+}
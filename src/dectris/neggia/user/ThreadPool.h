@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t numberOfThreads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t numberOfThreads() const;
+    // Tasks are run in the order they were enqueued. Tasks which are still
+    // queued when the pool is destroyed are run before the threads join.
+    void enqueue(std::function<void()> task);
+    // Runs task(0) to task(numberOfTasks - 1) on the calling thread and the
+    // pool threads and returns when all of them have finished. The calling
+    // thread takes tasks as well, so this may also be called from a task of
+    // the same pool. The remaining tasks are skipped after a task has thrown
+    // and the first exception is rethrown.
+    void parallelFor(size_t numberOfTasks,
+                     const std::function<void(size_t)>& task);
+
+private:
+    void work();
+
+    std::vector<std::thread> _threads;
+    std::deque<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _stop;
+};
+
+#endif  // THREADPOOL_H